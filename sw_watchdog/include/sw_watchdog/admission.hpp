@@ -0,0 +1,51 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__ADMISSION_HPP_
+#define SW_WATCHDOG__ADMISSION_HPP_
+
+#include <algorithm>
+#include <cstdint>
+
+#include "sw_watchdog/source_table.hpp"
+
+namespace sw_watchdog
+{
+
+/// Per-source token bucket admission of heartbeats
+/**
+ * The bucket of a source refills at rate tokens per second up to burst tokens; every admitted
+ * heartbeat takes one token. A heartbeat arriving at an empty bucket is dropped and counted, and
+ * the source is flagged as flooding until its bucket has filled up again. Returns whether the
+ * heartbeat is admitted. A source seen for the first time starts with a full bucket.
+ */
+inline bool admit_heartbeat(SourceState & source, float rate, float burst, int64_t now_ns)
+{
+    const float elapsed_s = static_cast<float>(now_ns - source.admission_refill_ns) * 1e-9f;
+    source.admission_refill_ns = now_ns;
+    source.admission_tokens = std::min(burst, source.admission_tokens + elapsed_s * rate);
+    if(source.admission_tokens >= burst)
+        source.flooding = false;
+    if(source.admission_tokens >= 1.0f) {
+        source.admission_tokens -= 1.0f;
+        return true;
+    }
+    ++source.dropped_beats;
+    source.flooding = true;
+    return false;
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__ADMISSION_HPP_
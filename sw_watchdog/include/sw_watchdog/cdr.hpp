@@ -0,0 +1,144 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__CDR_HPP_
+#define SW_WATCHDOG__CDR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace sw_watchdog
+{
+
+/// Reader for the leading fields of a serialized (XCDR1) message
+/**
+ * Decodes primitive fields in place, without copying or deserializing the rest of the sample.
+ * Every read checks the buffer bounds and returns false once the buffer is exhausted or the
+ * encapsulation is unknown.
+ */
+class CdrPeek
+{
+public:
+    CdrPeek(const uint8_t * buffer, std::size_t length)
+        : buffer_(buffer), length_(length)
+    {
+        // 4 byte encapsulation header: representation id (big endian) and options
+        if(!buffer_ || length_ < 4 || buffer_[0] != 0x00 || buffer_[1] > 0x01) {
+            valid_ = false;
+            return;
+        }
+        little_endian_ = buffer_[1] == 0x01;
+    }
+
+    bool valid() const { return valid_; }
+
+    bool read_u16(uint16_t * value)
+    {
+        uint8_t raw[2];
+        if(!read_raw(raw, sizeof(raw)))
+            return false;
+        *value = little_endian_ ? static_cast<uint16_t>(raw[0] | raw[1] << 8)
+                                : static_cast<uint16_t>(raw[1] | raw[0] << 8);
+        return true;
+    }
+
+    bool read_u32(uint32_t * value)
+    {
+        uint8_t raw[4];
+        if(!read_raw(raw, sizeof(raw)))
+            return false;
+        *value = 0;
+        for(int i = 0; i < 4; ++i)
+            *value |= static_cast<uint32_t>(raw[little_endian_ ? i : 3 - i]) << (8 * i);
+        return true;
+    }
+
+    bool read_i32(int32_t * value)
+    {
+        uint32_t raw;
+        if(!read_u32(&raw))
+            return false;
+        std::memcpy(value, &raw, sizeof(raw));
+        return true;
+    }
+
+    /// Skip a string (length prefix including the terminating null, then the characters)
+    bool skip_string()
+    {
+        uint32_t size;
+        if(!read_u32(&size) || size > length_ - position())
+            return valid_ = false;
+        offset_ += size;
+        return true;
+    }
+
+private:
+    std::size_t position() const { return 4 + offset_; }
+
+    bool read_raw(uint8_t * out, std::size_t size)
+    {
+        // Primitives are aligned to their size, relative to the end of the encapsulation header
+        offset_ = (offset_ + size - 1) & ~(size - 1);
+        if(!valid_ || position() + size > length_)
+            return valid_ = false;
+        std::memcpy(out, buffer_ + position(), size);
+        offset_ += size;
+        return true;
+    }
+
+    const uint8_t * buffer_;
+    std::size_t length_;
+    std::size_t offset_ = 0;
+    bool little_endian_ = true;
+    bool valid_ = true;
+};
+
+/// Read the stamp of a serialized message whose first field is a std_msgs/Header
+/**
+ * Only the first eight bytes after the encapsulation header are touched; the payload is neither
+ * copied nor deserialized. The message type is not known here, so a buffer that merely looks like
+ * it starts with a stamp cannot be told apart.
+ */
+inline bool peek_header_stamp(const uint8_t * buffer, std::size_t length, int64_t * stamp_ns)
+{
+    CdrPeek cdr(buffer, length);
+    int32_t sec;
+    uint32_t nanosec;
+    if(!cdr.read_i32(&sec) || !cdr.read_u32(&nanosec) || nanosec >= 1000000000u)
+        return false;
+    *stamp_ns = static_cast<int64_t>(sec) * 1000000000 + nanosec;
+    return true;
+}
+
+/// Read the checkpoint id of a serialized sw_watchdog_msgs/Heartbeat without deserializing it
+/**
+ * Relies on the field order of Heartbeat.msg: header (stamp, frame_id), stamp, checkpoint_id.
+ * New fields must only ever be appended to the message.
+ */
+inline bool peek_heartbeat_checkpoint_id(const uint8_t * buffer, std::size_t length,
+                                         uint16_t * checkpoint_id)
+{
+    CdrPeek cdr(buffer, length);
+    int32_t sec;
+    uint32_t nanosec;
+    return cdr.read_i32(&sec) && cdr.read_u32(&nanosec) &&   // header.stamp
+           cdr.skip_string() &&                               // header.frame_id
+           cdr.read_i32(&sec) && cdr.read_u32(&nanosec) &&   // stamp
+           cdr.read_u16(checkpoint_id);
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__CDR_HPP_
@@ -0,0 +1,89 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__CHECKPOINT_IDS_HPP_
+#define SW_WATCHDOG__CHECKPOINT_IDS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace sw_watchdog
+{
+
+/// First checkpoint id derived from a source name; ids below are handed out by registration
+constexpr uint16_t HASHED_CHECKPOINT_ID_BASE = 0x8000;
+
+/// Checkpoint id of a source that could not register, derived deterministically from its name
+/**
+ * 32 bit FNV-1a folded into the upper half of the id space, so it never collides with an id
+ * handed out by a CheckpointRegistry.
+ */
+inline uint16_t checkpoint_id_from_name(const std::string & name)
+{
+    uint32_t hash = 2166136261u;
+    for(const char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return static_cast<uint16_t>(HASHED_CHECKPOINT_ID_BASE | ((hash ^ (hash >> 16)) & 0x7fff));
+}
+
+/// Assignment of unique checkpoint ids to registering sources
+/**
+ * Ids are handed out densely from 0 in order of registration, so a watchdog can index per-source
+ * state directly by id. A name keeps its id for the lifetime of the registry, so a restarting
+ * source continues where it left off. A registry that starts while sources registered with a
+ * previous one are still running learns their ids from their heartbeats, see reserve().
+ */
+class CheckpointRegistry
+{
+public:
+    /// Look up or assign the id of the named source. Returns false if the id space is exhausted.
+    bool assign(const std::string & name, uint16_t * checkpoint_id)
+    {
+        const auto found = ids_.find(name);
+        if(found != ids_.end()) {
+            *checkpoint_id = found->second;
+            return true;
+        }
+        if(next_ == HASHED_CHECKPOINT_ID_BASE)
+            return false;
+        *checkpoint_id = next_++;
+        ids_.emplace(name, *checkpoint_id);
+        return true;
+    }
+
+    /// Mark an id seen in a heartbeat as taken, so it is never handed out to another source
+    /**
+     * The name holding the id is unknown, hence all ids up to it are skipped. O(1) and free of
+     * allocations, so it can be called for every heartbeat.
+     */
+    void reserve(uint16_t checkpoint_id)
+    {
+        if(checkpoint_id >= next_ && checkpoint_id < HASHED_CHECKPOINT_ID_BASE)
+            next_ = static_cast<uint16_t>(checkpoint_id + 1);
+    }
+
+    std::size_t size() const { return ids_.size(); }
+
+private:
+    std::unordered_map<std::string, uint16_t> ids_;
+    uint16_t next_ = 0;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__CHECKPOINT_IDS_HPP_
@@ -0,0 +1,55 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__CRITICALITY_HPP_
+#define SW_WATCHDOG__CRITICALITY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace sw_watchdog
+{
+
+/// Number of criticality levels; 0 is the default and lowest, the last one the most critical
+constexpr std::size_t CRITICALITY_LEVELS = 4;
+
+/// Heartbeat processing latency of one criticality class
+/**
+ * Measured from the executor wakeup that took a heartbeat to the moment its source state was
+ * updated, i.e., the time a heartbeat waited behind others of the same batch.
+ */
+struct ClassLatency
+{
+    uint64_t count = 0;
+    int64_t total_ns = 0;
+    int64_t max_ns = 0;
+
+    void record(int64_t latency_ns)
+    {
+        ++count;
+        total_ns += latency_ns;
+        max_ns = std::max(max_ns, latency_ns);
+    }
+
+    double mean_ns() const { return count ? static_cast<double>(total_ns) / count : 0.0; }
+};
+
+/// Latency statistics of all criticality classes
+using CriticalityLatencies = std::array<ClassLatency, CRITICALITY_LEVELS>;
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__CRITICALITY_HPP_
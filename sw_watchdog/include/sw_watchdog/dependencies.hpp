@@ -0,0 +1,183 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__DEPENDENCIES_HPP_
+#define SW_WATCHDOG__DEPENDENCIES_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sw_watchdog/source_table.hpp"
+
+namespace sw_watchdog
+{
+
+/// Directed acyclic graph of the dependencies between heartbeat sources
+/**
+ * An edge from an upstream to a downstream source states that the downstream source starves,
+ * and misses its heartbeats, once the upstream source is dead. Sources are numbered densely in
+ * the order they appear; adjacency is stored in compressed sparse row form.
+ */
+class DependencyGraph
+{
+public:
+    static constexpr uint32_t NIL = SlotIndex::NIL;
+
+    /// Build the graph from (downstream id, upstream id) pairs, rejecting cycles
+    bool build(const std::vector<std::pair<uint16_t, long>> & edges, std::string * error)
+    {
+        ids_.clear();
+        index_.reset(2 * edges.size());
+        std::vector<std::pair<uint32_t, uint32_t>> links;
+        links.reserve(edges.size());
+        for(const auto & edge : edges) {
+            if(edge.second < 0 || edge.second > UINT16_MAX || edge.second == edge.first) {
+                *error = "invalid upstream " + std::to_string(edge.second) + " of checkpoint " +
+                    std::to_string(edge.first);
+                return false;
+            }
+            links.emplace_back(add(static_cast<uint16_t>(edge.second)), add(edge.first));
+        }
+        build_rows(links, &down_begin_, &down_, false);
+        build_rows(links, &up_begin_, &up_, true);
+
+        // Kahn's algorithm: every node has to be removable in topological order
+        std::vector<uint32_t> in_degree(size()), ready;
+        for(uint32_t node = 0; node < size(); ++node)
+            if(!(in_degree[node] = up_begin_[node + 1] - up_begin_[node]))
+                ready.push_back(node);
+        std::size_t removed = 0;
+        while(!ready.empty()) {
+            const uint32_t node = ready.back();
+            ready.pop_back();
+            ++removed;
+            for(uint32_t i = down_begin_[node]; i < down_begin_[node + 1]; ++i)
+                if(!--in_degree[down_[i]])
+                    ready.push_back(down_[i]);
+        }
+        if(removed != size()) {
+            *error = "dependencies contain a cycle";
+            return false;
+        }
+        return true;
+    }
+
+    bool empty() const { return ids_.empty(); }
+    uint32_t size() const { return static_cast<uint32_t>(ids_.size()); }
+    uint16_t id(uint32_t node) const { return ids_[node]; }
+    /// Node of a checkpoint id, NIL if the source takes no part in any dependency
+    uint32_t node(uint16_t checkpoint_id) const
+    {
+        return empty() ? NIL : index_.find(checkpoint_id);
+    }
+
+    /// Invoke f(node) for every direct upstream / downstream node
+    template<typename F>
+    void for_each_upstream(uint32_t node, F && f) const
+    {
+        for(uint32_t i = up_begin_[node]; i < up_begin_[node + 1]; ++i)
+            f(up_[i]);
+    }
+    template<typename F>
+    void for_each_downstream(uint32_t node, F && f) const
+    {
+        for(uint32_t i = down_begin_[node]; i < down_begin_[node + 1]; ++i)
+            f(down_[i]);
+    }
+
+private:
+    uint32_t add(uint16_t checkpoint_id)
+    {
+        uint32_t node = index_.find(checkpoint_id);
+        if(node == NIL) {
+            node = size();
+            index_.insert(checkpoint_id, node);
+            ids_.push_back(checkpoint_id);
+        }
+        return node;
+    }
+
+    void build_rows(const std::vector<std::pair<uint32_t, uint32_t>> & links,
+                    std::vector<uint32_t> * begin, std::vector<uint32_t> * targets,
+                    bool reverse) const
+    {
+        begin->assign(size() + 1, 0);
+        targets->resize(links.size());
+        for(const auto & link : links)
+            ++(*begin)[(reverse ? link.second : link.first) + 1];
+        for(uint32_t node = 0; node < size(); ++node)
+            (*begin)[node + 1] += (*begin)[node];
+        std::vector<uint32_t> fill(begin->begin(), begin->end() - 1);
+        for(const auto & link : links)
+            (*targets)[fill[reverse ? link.second : link.first]++] =
+                reverse ? link.first : link.second;
+    }
+
+    SlotIndex index_;
+    std::vector<uint16_t> ids_;
+    std::vector<uint32_t> up_begin_, up_;
+    std::vector<uint32_t> down_begin_, down_;
+};
+
+/// Liveness of the sources of a DependencyGraph, updated incrementally
+/**
+ * Each node counts its dead direct upstream nodes. A state change only touches the direct
+ * downstream nodes; since a consequential failure marks its node dead as well, a failure
+ * propagates along the graph one node per transition, so the work done is proportional to the
+ * affected subgraph.
+ */
+class DependencyState
+{
+public:
+    void reset(const DependencyGraph & graph)
+    {
+        down_.assign(graph.size(), false);
+        dead_upstream_.assign(graph.size(), 0);
+    }
+
+    bool down(uint32_t node) const { return down_[node]; }
+    /// Whether a failure of the node is the consequence of a dead upstream node
+    bool consequential(uint32_t node) const { return dead_upstream_[node] > 0; }
+
+    /// Record that the node died or came back
+    /**
+     * When a node comes back, f(node) is invoked for every downstream node that is still down
+     * but no longer has a dead upstream node, i.e., whose failure has become a root cause.
+     */
+    template<typename F>
+    void set_down(const DependencyGraph & graph, uint32_t node, bool down, F && f)
+    {
+        if(down_[node] == down)
+            return;
+        down_[node] = down;
+        graph.for_each_downstream(node, [&](uint32_t child) {
+            if(down) {
+                ++dead_upstream_[child];
+            } else if(!--dead_upstream_[child] && down_[child]) {
+                f(child);
+            }
+        });
+    }
+
+private:
+    std::vector<bool> down_;
+    std::vector<uint32_t> dead_upstream_;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__DEPENDENCIES_HPP_
@@ -0,0 +1,143 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__EXECUTOR_PROGRESS_HPP_
+#define SW_WATCHDOG__EXECUTOR_PROGRESS_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "sw_watchdog/visibility_control.h"
+
+namespace sw_watchdog
+{
+
+/// Dispatch progress of the executor spinning the process, and the beats it runs
+/**
+ * Updated by ProgressExecutor from its spin loop. Heartbeats register a beat that the loop runs
+ * once per period between dispatches, so a beat is only sent while the loop itself moves forward.
+ * The loop pays one atomic load and a compare per iteration while no beat is due.
+ */
+class ExecutorProgress
+{
+public:
+    /// Load of the executor, as passed to a beat
+    struct Load
+    {
+        /// Executables dispatched so far
+        uint64_t dispatched = 0;
+        /// Largest number of executables dispatched in one wakeup since the beat before
+        uint32_t backlog = 0;
+        /// Longest time spent dispatching in one wakeup since the beat before
+        int64_t loop_time_ns = 0;
+    };
+
+    using Beat = std::function<void(const Load & load)>;
+
+    /// Whether a ProgressExecutor spins in this process
+    bool attached() const { return attached_.load(std::memory_order_acquire); }
+    void attach(bool attached) { attached_.store(attached, std::memory_order_release); }
+
+    uint64_t dispatched() const { return dispatched_.load(std::memory_order_relaxed); }
+
+    /// Record the executables dispatched in one wakeup of the loop (executor thread only)
+    void record_wakeup(uint32_t dispatched, int64_t duration_ns)
+    {
+        dispatched_.fetch_add(dispatched, std::memory_order_relaxed);
+        burst_max_ = std::max(burst_max_, dispatched);
+        duration_max_ns_ = std::max(duration_max_ns_, duration_ns);
+    }
+
+    /// Run beat every period from the spin loop until remove_beat(owner)
+    void add_beat(const void * owner, std::chrono::nanoseconds period, Beat beat, int64_t now_ns)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        beats_.push_back(Entry{owner, period.count(), now_ns + period.count(), Load(),
+                               std::move(beat)});
+        next_due_ns_.store(std::min(next_due_ns_.load(), now_ns + period.count()));
+    }
+
+    void remove_beat(const void * owner)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        beats_.erase(std::remove_if(beats_.begin(), beats_.end(),
+                                    [owner](const Entry & entry) { return entry.owner == owner; }),
+                     beats_.end());
+    }
+
+    /// Run the due beats (executor thread only)
+    /**
+     * Returns the time until the next beat is due, so the loop wakes up for it while idle, or a
+     * negative duration if no beat is registered.
+     */
+    std::chrono::nanoseconds run_due_beats(int64_t now_ns)
+    {
+        const int64_t next_due_ns = next_due_ns_.load(std::memory_order_relaxed);
+        if(next_due_ns == INT64_MAX)
+            return std::chrono::nanoseconds(-1);
+        if(now_ns < next_due_ns)
+            return std::chrono::nanoseconds(next_due_ns - now_ns);
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t next_ns = INT64_MAX;
+        for(Entry & entry : beats_) {
+            entry.load.backlog = std::max(entry.load.backlog, burst_max_);
+            entry.load.loop_time_ns = std::max(entry.load.loop_time_ns, duration_max_ns_);
+            if(now_ns >= entry.due_ns) {
+                entry.load.dispatched = dispatched();
+                entry.beat(entry.load);
+                entry.load = Load();
+                // Skip missed periods rather than bursting to catch up
+                entry.due_ns = std::max(entry.due_ns + entry.period_ns, now_ns + 1);
+            }
+            next_ns = std::min(next_ns, entry.due_ns);
+        }
+        burst_max_ = 0;
+        duration_max_ns_ = 0;
+        next_due_ns_.store(next_ns, std::memory_order_relaxed);
+        return next_ns == INT64_MAX ? std::chrono::nanoseconds(-1)
+                                    : std::chrono::nanoseconds(next_ns - now_ns);
+    }
+
+private:
+    struct Entry
+    {
+        const void * owner;
+        int64_t period_ns;
+        int64_t due_ns;
+        /// Load accumulated since the last beat
+        Load load;
+        Beat beat;
+    };
+
+    std::atomic<bool> attached_{false};
+    std::atomic<uint64_t> dispatched_{0};
+    uint32_t burst_max_ = 0;
+    int64_t duration_max_ns_ = 0;
+    std::atomic<int64_t> next_due_ns_{INT64_MAX};
+    std::mutex mutex_;
+    std::vector<Entry> beats_;
+};
+
+/// The progress of the executor of this process, shared by all components loaded into it
+SW_WATCHDOG_PUBLIC ExecutorProgress & executor_progress();
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__EXECUTOR_PROGRESS_HPP_
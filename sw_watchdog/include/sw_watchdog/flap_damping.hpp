@@ -0,0 +1,88 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__FLAP_DAMPING_HPP_
+#define SW_WATCHDOG__FLAP_DAMPING_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace sw_watchdog
+{
+
+/// Parameters of flap damping
+/**
+ * Every alive/dead transition of a source adds penalty to its flap score, which decays
+ * exponentially with half_life. A source whose score exceeds suppress is damped: its further
+ * transitions are not reported individually. It is released once the score has decayed below
+ * reuse. A half-life of zero disables damping.
+ */
+struct FlapDampingParams
+{
+    float half_life_s = 0.0f;
+    float penalty = 1000.0f;
+    float suppress = 2000.0f;
+    float reuse = 750.0f;
+    /// Upper bound of the score, limits how long a source stays damped after flapping stops
+    float ceiling = 4000.0f;
+
+    bool enabled() const { return half_life_s > 0.0f; }
+};
+
+/// Flap score of one source
+struct FlapState
+{
+    // Widest member first, so the state packs into 16 bytes
+    int64_t updated_ns = 0;
+    float score = 0.0f;
+    bool damped = false;
+};
+
+/// Apply the exponential decay up to now_ns and release the damping if the score fell below reuse
+/**
+ * Returns true if the source was damped and has just been released.
+ */
+inline bool flap_decay(FlapState & state, const FlapDampingParams & params, int64_t now_ns)
+{
+    if(state.score > 0.0f) {
+        const float elapsed_s = static_cast<float>(now_ns - state.updated_ns) * 1e-9f;
+        state.score *= std::exp2(-elapsed_s / params.half_life_s);
+    }
+    state.updated_ns = now_ns;
+    if(state.damped && state.score < params.reuse) {
+        state.damped = false;
+        return true;
+    }
+    return false;
+}
+
+/// Record an alive/dead transition
+/**
+ * Returns true if the source has just become damped by this transition.
+ */
+inline bool flap_transition(FlapState & state, const FlapDampingParams & params, int64_t now_ns)
+{
+    flap_decay(state, params, now_ns);
+    state.score = std::min(params.ceiling, state.score + params.penalty);
+    if(!state.damped && state.score >= params.suppress) {
+        state.damped = true;
+        return true;
+    }
+    return false;
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__FLAP_DAMPING_HPP_
@@ -0,0 +1,114 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__PERFECT_HASH_HPP_
+#define SW_WATCHDOG__PERFECT_HASH_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sw_watchdog
+{
+
+/// Minimal perfect hash over a fixed set of checkpoint ids (hash and displace)
+/**
+ * Maps each of the n ids it was built from to a distinct index in [0, n). Keys are first hashed
+ * into n buckets; every bucket stores the seed that places all of its keys into free positions.
+ * A lookup is two hash evaluations and one load, without any probing, whichever ids were given.
+ * Ids outside the set map to an arbitrary index, so callers have to compare the stored key.
+ */
+class PerfectHash
+{
+public:
+    /// Build the hash over distinct ids. Returns false if no seed placed some bucket.
+    bool build(const std::vector<uint16_t> & ids)
+    {
+        size_ = static_cast<uint32_t>(ids.size());
+        seeds_.assign(std::max<uint32_t>(1, size_), 0);
+        if(ids.empty())
+            return true;
+
+        std::vector<std::vector<uint16_t>> buckets(seeds_.size());
+        for(const uint16_t id : ids)
+            buckets[reduce(mix(id, 0), static_cast<uint32_t>(seeds_.size()))].push_back(id);
+        std::vector<uint32_t> order(buckets.size());
+        for(uint32_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        // Place the largest buckets first, while most positions are still free
+        std::sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::vector<bool> taken(size_, false);
+        std::vector<uint32_t> positions;
+        for(const uint32_t bucket : order) {
+            if(buckets[bucket].empty())
+                break;
+            uint32_t seed = 1;
+            for(; seed < MAX_SEED; ++seed) {
+                positions.clear();
+                for(const uint16_t id : buckets[bucket]) {
+                    const uint32_t position = reduce(mix(id, seed), size_);
+                    if(taken[position] ||
+                       std::find(positions.begin(), positions.end(), position) != positions.end())
+                        break;
+                    positions.push_back(position);
+                }
+                if(positions.size() == buckets[bucket].size())
+                    break;
+            }
+            if(seed == MAX_SEED)
+                return false;
+            seeds_[bucket] = seed;
+            for(const uint32_t position : positions)
+                taken[position] = true;
+        }
+        return true;
+    }
+
+    bool empty() const { return size_ == 0; }
+    uint32_t size() const { return size_; }
+
+    uint32_t index(uint16_t id) const
+    {
+        const uint32_t seed = seeds_[reduce(mix(id, 0), static_cast<uint32_t>(seeds_.size()))];
+        return reduce(mix(id, seed), size_);
+    }
+
+private:
+    static constexpr uint32_t MAX_SEED = 1u << 20;
+
+    static uint32_t mix(uint16_t id, uint32_t seed)
+    {
+        // Two multiplications and a shift, enough to spread 16 bit keys for every seed
+        uint32_t h = (id + seed * 0x9e3779b9u) * 0x85ebca6bu;
+        h ^= h >> 15;
+        return h * 0xc2b2ae35u;
+    }
+
+    /// Map a hash onto [0, n) without a division
+    static uint32_t reduce(uint32_t hash, uint32_t n)
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(hash) * n) >> 32);
+    }
+
+    uint32_t size_ = 0;
+    std::vector<uint32_t> seeds_;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__PERFECT_HASH_HPP_
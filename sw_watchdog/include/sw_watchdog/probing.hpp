@@ -0,0 +1,85 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__PROBING_HPP_
+#define SW_WATCHDOG__PROBING_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace sw_watchdog
+{
+
+/// Number of probes whose send times are kept; older responses carry no round-trip time
+constexpr std::size_t PROBE_WINDOW = 64;
+
+/// Send times of the outstanding probes
+/**
+ * Probes are pipelined: a new probe goes out every probe period regardless of the responses to
+ * the previous ones. Sequence numbers start at 1, 0 marks a heartbeat that answers no probe.
+ */
+class ProbeWindow
+{
+public:
+    /// Record a probe sent at now_ns and return its sequence number
+    uint32_t send(int64_t now_ns)
+    {
+        if(++seq_ == 0)
+            ++seq_;
+        sent_ns_[seq_ % PROBE_WINDOW] = now_ns;
+        sent_seq_[seq_ % PROBE_WINDOW] = seq_;
+        return seq_;
+    }
+
+    /// Round-trip time of a response to probe seq received at now_ns
+    /**
+     * Returns false if seq is 0, not sent by this window or has dropped out of it.
+     */
+    bool rtt(uint32_t seq, int64_t now_ns, int64_t * rtt_ns) const
+    {
+        if(seq == 0 || sent_seq_[seq % PROBE_WINDOW] != seq)
+            return false;
+        *rtt_ns = std::max<int64_t>(0, now_ns - sent_ns_[seq % PROBE_WINDOW]);
+        return true;
+    }
+
+private:
+    uint32_t seq_ = 0;
+    std::array<int64_t, PROBE_WINDOW> sent_ns_{};
+    std::array<uint32_t, PROBE_WINDOW> sent_seq_{};
+};
+
+/// Fold a round-trip time sample into the smoothed round-trip time and its mean deviation
+/**
+ * Gains of 1/8 and 1/4 as in the TCP retransmission timer (RFC 6298); the first sample
+ * initializes both.
+ */
+inline void update_rtt(uint32_t & srtt_ns, uint32_t & rttvar_ns, int64_t rtt_ns)
+{
+    const int64_t sample = std::min<int64_t>(rtt_ns, UINT32_MAX);
+    if(srtt_ns == 0) {
+        srtt_ns = static_cast<uint32_t>(std::max<int64_t>(sample, 1));
+        rttvar_ns = static_cast<uint32_t>(sample / 2);
+        return;
+    }
+    const int64_t error = sample - srtt_ns;
+    rttvar_ns = static_cast<uint32_t>(rttvar_ns + ((error < 0 ? -error : error) - rttvar_ns) / 4);
+    srtt_ns = static_cast<uint32_t>(std::max<int64_t>(srtt_ns + error / 8, 1));
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__PROBING_HPP_
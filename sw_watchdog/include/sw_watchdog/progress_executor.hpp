@@ -0,0 +1,78 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__PROGRESS_EXECUTOR_HPP_
+#define SW_WATCHDOG__PROGRESS_EXECUTOR_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+#include "rclcpp/executors/single_threaded_executor.hpp"
+#include "rclcpp/scope_exit.hpp"
+#include "rclcpp/utilities.hpp"
+
+#include "sw_watchdog/executor_progress.hpp"
+
+namespace sw_watchdog
+{
+
+/// Single-threaded executor that accounts its dispatches in executor_progress()
+/**
+ * Each wakeup dispatches everything that is ready, then the due beats run. The number of
+ * executables ready at one wakeup is the backlog reported with the beats; a subscription with
+ * several queued messages counts once. While idle, the wait ends when the next beat is due.
+ */
+class ProgressExecutor : public rclcpp::executors::SingleThreadedExecutor
+{
+public:
+    explicit ProgressExecutor(
+        const rclcpp::ExecutorOptions & options = rclcpp::ExecutorOptions())
+        : rclcpp::executors::SingleThreadedExecutor(options)
+    {}
+
+    void spin() override
+    {
+        if(spinning.exchange(true))
+            throw std::runtime_error("spin() called while already spinning");
+        ExecutorProgress & progress = executor_progress();
+        progress.attach(true);
+        RCLCPP_SCOPE_EXIT(this->spinning.store(false); executor_progress().attach(false); );
+        while(rclcpp::ok(this->context_) && spinning.load()) {
+            const std::chrono::nanoseconds timeout = progress.run_due_beats(now_ns());
+            rclcpp::AnyExecutable any_executable;
+            if(!get_next_executable(any_executable, timeout))
+                continue;
+            const int64_t woken_ns = now_ns();
+            execute_any_executable(any_executable);
+            uint32_t dispatched = 1;
+            while(get_next_ready_executable(any_executable)) {
+                execute_any_executable(any_executable);
+                ++dispatched;
+            }
+            progress.record_wakeup(dispatched, now_ns() - woken_ns);
+        }
+    }
+
+private:
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__PROGRESS_EXECUTOR_HPP_
@@ -0,0 +1,258 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__RCU_HPP_
+#define SW_WATCHDOG__RCU_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "sw_watchdog/sharded_counter.hpp"
+
+namespace sw_watchdog
+{
+
+/// Number of reader slots. Further reader threads share an overflow slot that defers reclamation.
+constexpr std::size_t RCU_MAX_READERS = 64;
+
+namespace detail
+{
+
+/// Bits of a reader word holding the epoch; the remaining high bits hold the slot generation
+constexpr unsigned RCU_EPOCH_BITS = 40;
+constexpr uint64_t RCU_EPOCH_MASK = (uint64_t(1) << RCU_EPOCH_BITS) - 1;
+
+/// Reader slot of a thread and the generation of the slot when the thread claimed it
+struct RcuReader
+{
+    std::size_t slot;
+    uint64_t generation;
+};
+
+/// Process wide assignment of reader slots to threads
+/**
+ * A thread claims a slot on its first RCU read and returns it when it exits. Slot indices are
+ * shared by all RcuCell instances, so a thread needs exactly one slot no matter how many cells it
+ * reads. Returning a slot bumps its generation, which invalidates whatever the exited thread left
+ * in the cells. Threads beyond RCU_MAX_READERS get the overflow slot instead of an error.
+ */
+class RcuReaderRegistry
+{
+public:
+    static constexpr std::size_t OVERFLOW_SLOT = RCU_MAX_READERS;
+
+    static RcuReaderRegistry & instance()
+    {
+        static RcuReaderRegistry registry;
+        return registry;
+    }
+
+    RcuReader claim()
+    {
+        for(std::size_t i = 0; i < RCU_MAX_READERS; ++i) {
+            bool expected = false;
+            if(in_use_[i].compare_exchange_strong(expected, true))
+                return RcuReader{i, generation(i)};
+        }
+        overflow_readers_.fetch_add(1, std::memory_order_seq_cst);
+        return RcuReader{OVERFLOW_SLOT, 0};
+    }
+
+    void release(const RcuReader & reader)
+    {
+        if(reader.slot == OVERFLOW_SLOT) {
+            overflow_readers_.fetch_sub(1, std::memory_order_seq_cst);
+            return;
+        }
+        generations_[reader.slot].fetch_add(1, std::memory_order_seq_cst);
+        in_use_[reader.slot].store(false);
+    }
+
+    /// Current generation of a slot, truncated to the bits a reader word has room for
+    uint64_t generation(std::size_t slot) const
+    {
+        return generations_[slot].load(std::memory_order_seq_cst) &
+            (~uint64_t(0) >> RCU_EPOCH_BITS);
+    }
+
+    /// Number of live threads on the overflow slot
+    std::size_t overflow_readers() const
+    {
+        return overflow_readers_.load(std::memory_order_seq_cst);
+    }
+
+private:
+    std::atomic<bool> in_use_[RCU_MAX_READERS] = {};
+    std::atomic<uint64_t> generations_[RCU_MAX_READERS] = {};
+    std::atomic<std::size_t> overflow_readers_{0};
+};
+
+/// Reader slot of the calling thread, claimed on first use and released on thread exit
+inline const RcuReader & rcu_reader()
+{
+    struct Handle
+    {
+        Handle() : reader(RcuReaderRegistry::instance().claim()) {}
+        ~Handle() { RcuReaderRegistry::instance().release(reader); }
+        const RcuReader reader;
+    };
+    thread_local const Handle handle;
+    return handle.reader;
+}
+
+} // namespace detail
+
+/// Immutable snapshot of T that is replaced as a whole (read-copy-update)
+/**
+ * Readers obtain the current snapshot with a single load and never block; only the first read
+ * after a quiescent state also stores the reader's epoch. Writers build a new snapshot, swap it
+ * in atomically and retire the previous one. Retired snapshots are reclaimed once every thread
+ * that read this cell has passed a quiescent state, i.e., has announced that it no longer holds
+ * any snapshot pointer (quiescent-state based reclamation).
+ *
+ * A thread is registered as a reader of a cell from its first read() until its next
+ * quiescent_state() on that cell, or until it exits. Threads that never read a cell, or read it
+ * once during setup and announced their quiescent state, do not hold back its reclamation.
+ * Reader threads have to call quiescent_state() regularly, e.g., at the end of every callback. A
+ * snapshot pointer must not be used across that call.
+ */
+template<typename T>
+class RcuCell
+{
+public:
+    explicit RcuCell(std::unique_ptr<const T> initial)
+        : current_(initial.release())
+    {
+    }
+
+    RcuCell(const RcuCell &) = delete;
+    RcuCell & operator=(const RcuCell &) = delete;
+
+    ~RcuCell()
+    {
+        delete current_.load();
+        for(auto & retired : retired_)
+            delete retired.first;
+    }
+
+    /// Current snapshot, valid until the calling thread's next quiescent_state()
+    const T * read() const
+    {
+        // Claiming the slot only happens once per thread; afterwards this is a TLS lookup.
+        const detail::RcuReader & reader = detail::rcu_reader();
+        if(reader.slot != detail::RcuReaderRegistry::OVERFLOW_SLOT) {
+            std::atomic<uint64_t> & word = readers_[reader.slot].word;
+            const uint64_t seen = word.load(std::memory_order_relaxed);
+            // Keep the epoch of the first read; older snapshots may still be referenced
+            if(!(seen & detail::RCU_EPOCH_MASK) ||
+               seen >> detail::RCU_EPOCH_BITS != reader.generation)
+                word.store(reader.generation << detail::RCU_EPOCH_BITS |
+                           epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        }
+        return current_.load(std::memory_order_seq_cst);
+    }
+
+    /// Announce that the calling thread holds no snapshot pointer of this cell anymore
+    void quiescent_state()
+    {
+        const detail::RcuReader & reader = detail::rcu_reader();
+        if(reader.slot != detail::RcuReaderRegistry::OVERFLOW_SLOT)
+            readers_[reader.slot].word.store(reader.generation << detail::RCU_EPOCH_BITS,
+                                             std::memory_order_release);
+    }
+
+    /// Publish a new snapshot and retire the previous one
+    /**
+     * Implies a quiescent state of the calling thread, which typically read the previous snapshot
+     * to build the next one.
+     */
+    void update(std::unique_ptr<const T> next)
+    {
+        quiescent_state();
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        const T * previous = current_.exchange(next.release(), std::memory_order_seq_cst);
+        const uint64_t retire_epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        retired_.emplace_back(previous, retire_epoch);
+        reclaim_locked();
+    }
+
+    /// Free retired snapshots that no reader can reference anymore. Returns the number freed.
+    std::size_t reclaim()
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        return reclaim_locked();
+    }
+
+    /// Number of retired snapshots still waiting for a grace period
+    std::size_t pending() const
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        return retired_.size();
+    }
+
+private:
+    std::size_t reclaim_locked()
+    {
+        const detail::RcuReaderRegistry & registry = detail::RcuReaderRegistry::instance();
+        // Threads on the overflow slot are not tracked individually
+        if(registry.overflow_readers())
+            return 0;
+        uint64_t grace_epoch = epoch_.load(std::memory_order_seq_cst);
+        for(std::size_t i = 0; i < RCU_MAX_READERS; ++i) {
+            const uint64_t word = readers_[i].word.load(std::memory_order_seq_cst);
+            const uint64_t seen = word & detail::RCU_EPOCH_MASK;
+            // Skip quiescent readers and words left behind by exited threads
+            if(!seen || word >> detail::RCU_EPOCH_BITS != registry.generation(i))
+                continue;
+            if(seen < grace_epoch)
+                grace_epoch = seen;
+        }
+
+        std::size_t freed = 0;
+        auto it = retired_.begin();
+        while(it != retired_.end()) {
+            // A reader registered at epoch e may hold any snapshot retired after e
+            if(it->second <= grace_epoch) {
+                delete it->first;
+                it = retired_.erase(it);
+                ++freed;
+            } else {
+                ++it;
+            }
+        }
+        return freed;
+    }
+
+    /// Generation of the reader slot and the epoch of its first read, zero while quiescent
+    struct alignas(CACHELINE_SIZE) ReaderWord
+    {
+        std::atomic<uint64_t> word{0};
+    };
+
+    std::atomic<const T *> current_;
+    /// Incremented on every update, starting at one as epoch zero marks a quiescent reader
+    std::atomic<uint64_t> epoch_{1};
+    mutable ReaderWord readers_[RCU_MAX_READERS];
+    mutable std::mutex writer_mutex_;
+    std::vector<std::pair<const T *, uint64_t>> retired_;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__RCU_HPP_
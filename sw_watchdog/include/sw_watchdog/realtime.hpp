@@ -0,0 +1,58 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__REALTIME_HPP_
+#define SW_WATCHDOG__REALTIME_HPP_
+
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace sw_watchdog
+{
+
+/// Stack the active-state callbacks are allowed to touch without page faults
+constexpr std::size_t REALTIME_STACK_PREFAULT = 128 * 1024;
+
+/// Touch the given amount of stack so the pages are mapped before they are needed
+inline void prefault_stack(std::size_t size = REALTIME_STACK_PREFAULT)
+{
+    volatile unsigned char * stack = static_cast<volatile unsigned char *>(__builtin_alloca(size));
+    for(std::size_t i = 0; i < size; i += 4096)
+        stack[i] = 0;
+}
+
+/// Lock all current and future pages of the process into RAM and prefault the calling stack
+/**
+ * Returns false and fills error if the pages could not be locked, typically because the
+ * process lacks CAP_IPC_LOCK or RLIMIT_MEMLOCK is too low. The lock covers the whole process,
+ * including any other component loaded into the same container.
+ */
+inline bool lock_memory(std::string * error)
+{
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        if(error)
+            *error = std::string("mlockall failed: ") + std::strerror(errno);
+        return false;
+    }
+    prefault_stack();
+    return true;
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__REALTIME_HPP_
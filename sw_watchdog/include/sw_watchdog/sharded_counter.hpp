@@ -0,0 +1,98 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__SHARDED_COUNTER_HPP_
+#define SW_WATCHDOG__SHARDED_COUNTER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sw_watchdog
+{
+
+/// Size of a cache line on the platforms we deploy to (x86-64, aarch64).
+constexpr std::size_t CACHELINE_SIZE = 64;
+
+namespace detail
+{
+
+/// Small, stable index of the calling thread, assigned on first use.
+inline std::size_t thread_index()
+{
+    static std::atomic<std::size_t> next_index{0};
+    thread_local const std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+} // namespace detail
+
+/// Counter split into per-thread shards that are merged on read
+/**
+ * Every shard occupies its own cache line, so executor threads that update the counter
+ * concurrently do not bounce a shared line between their cores. Writers pick a shard by their
+ * thread index, readers sum up all shards. Meant for counters that are written on every event
+ * and read comparatively rarely. A counter confined to one mutually exclusive callback group
+ * never sees two writers at once and is better served by a plain std::atomic.
+ */
+template<std::size_t NumShards = 16>
+class ShardedCounter
+{
+public:
+    ShardedCounter() = default;
+    ShardedCounter(const ShardedCounter &) = delete;
+    ShardedCounter & operator=(const ShardedCounter &) = delete;
+
+    /// Add to the shard of the calling thread
+    void add(uint64_t delta)
+    {
+        shards_[detail::thread_index() % NumShards].value.fetch_add(delta,
+                                                                   std::memory_order_relaxed);
+    }
+
+    /// Merge all shards. Concurrent adds may or may not be included.
+    uint64_t load() const
+    {
+        uint64_t sum = 0;
+        for(const Shard & shard : shards_)
+            sum += shard.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    /// Reset all shards to zero and return the sum taken from them
+    /**
+     * Every shard is swapped out, so each concurrent add either lands in the returned sum or
+     * stays in the counter; none is lost or counted twice.
+     */
+    uint64_t reset()
+    {
+        uint64_t sum = 0;
+        for(Shard & shard : shards_)
+            sum += shard.value.exchange(0, std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    struct alignas(CACHELINE_SIZE) Shard
+    {
+        std::atomic<uint64_t> value{0};
+    };
+    static_assert(sizeof(Shard) == CACHELINE_SIZE, "a shard has to fill exactly one cache line");
+
+    Shard shards_[NumShards];
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__SHARDED_COUNTER_HPP_
@@ -0,0 +1,242 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__SOURCE_GROUPS_HPP_
+#define SW_WATCHDOG__SOURCE_GROUPS_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sw_watchdog/source_table.hpp"
+
+namespace sw_watchdog
+{
+
+/// Parse a "<name>:<value>:<checkpoint id>[,<checkpoint id>...]" entry
+/**
+ * The ids keep their order. Returns false on a malformed entry, an empty name or duplicate ids.
+ */
+inline bool parse_source_set(const std::string & entry, std::string * name, long * value,
+                             std::vector<uint16_t> * ids)
+{
+    const std::size_t first = entry.find(':');
+    const std::size_t second =
+        first == std::string::npos ? std::string::npos : entry.find(':', first + 1);
+    ids->clear();
+    try {
+        if(second == std::string::npos || first == 0)
+            throw std::invalid_argument("missing ':'");
+        *name = entry.substr(0, first);
+        *value = std::stol(entry.substr(first + 1, second - first - 1));
+        std::size_t begin = second + 1;
+        while(begin <= entry.size()) {
+            std::size_t end = entry.find(',', begin);
+            if(end == std::string::npos)
+                end = entry.size();
+            const long id = std::stol(entry.substr(begin, end - begin));
+            if(id < 0 || id > UINT16_MAX)
+                throw std::out_of_range("checkpoint id");
+            ids->push_back(static_cast<uint16_t>(id));
+            begin = end + 1;
+        }
+    } catch(const std::exception &) {
+        return false;
+    }
+    std::vector<uint16_t> sorted(*ids);
+    std::sort(sorted.begin(), sorted.end());
+    return std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+}
+
+/// Membership of sources in a number of sets
+/**
+ * A source may be a member of several sets. Members are numbered densely; the sets of a member
+ * and its position in each of them are stored in compressed sparse row form.
+ */
+class SetMembership
+{
+public:
+    static constexpr uint32_t NIL = SlotIndex::NIL;
+
+    void build(const std::vector<std::vector<uint16_t>> & sets)
+    {
+        ids_.clear();
+        std::size_t total = 0;
+        for(const auto & ids : sets)
+            total += ids.size();
+        index_.reset(total);
+        std::vector<std::pair<uint32_t, Entry>> memberships;
+        for(uint32_t set = 0; set < sets.size(); ++set)
+            for(uint16_t position = 0; position < sets[set].size(); ++position)
+                memberships.emplace_back(add(sets[set][position]), Entry{set, position});
+
+        begin_.assign(ids_.size() + 1, 0);
+        for(const auto & membership : memberships)
+            ++begin_[membership.first + 1];
+        for(std::size_t member = 0; member < ids_.size(); ++member)
+            begin_[member + 1] += begin_[member];
+        entries_.resize(memberships.size());
+        std::vector<uint32_t> fill(begin_.begin(), begin_.end() - 1);
+        for(const auto & membership : memberships)
+            entries_[fill[membership.first]++] = membership.second;
+    }
+
+    uint32_t members() const { return static_cast<uint32_t>(ids_.size()); }
+
+    /// Member number of a checkpoint id, NIL if the source is in no set
+    uint32_t member(uint16_t checkpoint_id) const
+    {
+        return ids_.empty() ? NIL : index_.find(checkpoint_id);
+    }
+
+    /// Invoke f(set index, position in the set) for every set of a member
+    template<typename F>
+    void for_each_set(uint32_t member, F && f) const
+    {
+        for(uint32_t i = begin_[member]; i < begin_[member + 1]; ++i)
+            f(entries_[i].set, entries_[i].position);
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t set;
+        uint16_t position;
+    };
+
+    uint32_t add(uint16_t checkpoint_id)
+    {
+        uint32_t member = index_.find(checkpoint_id);
+        if(member == NIL) {
+            member = static_cast<uint32_t>(ids_.size());
+            index_.insert(checkpoint_id, member);
+            ids_.push_back(checkpoint_id);
+        }
+        return member;
+    }
+
+    SlotIndex index_;
+    std::vector<uint16_t> ids_;
+    std::vector<uint32_t> begin_;
+    std::vector<Entry> entries_;
+};
+
+/// Groups of redundant sources, each healthy while at least k of its n members are alive
+class SourceGroups
+{
+public:
+    static constexpr uint32_t NIL = SetMembership::NIL;
+
+    struct Group
+    {
+        std::string name;
+        /// Number of members that have to be alive for the group to be healthy
+        uint16_t required = 0;
+        uint16_t members = 0;
+    };
+
+    /// Build the groups from "<group>:<k>:<checkpoint id>[,<checkpoint id>...]" entries
+    bool build(const std::vector<std::string> & entries, std::string * error)
+    {
+        groups_.clear();
+        std::vector<std::vector<uint16_t>> group_ids;
+        for(const std::string & entry : entries) {
+            Group group;
+            long required;
+            std::vector<uint16_t> ids;
+            if(!parse_source_set(entry, &group.name, &required, &ids) || required < 1 ||
+               required > static_cast<long>(ids.size())) {
+                *error = "malformed entry '" + entry + "', expected <group>:<k>:<checkpoint id>"
+                    "[,<checkpoint id>...] with distinct ids and 1 <= k <= number of ids";
+                return false;
+            }
+            group.required = static_cast<uint16_t>(required);
+            group.members = static_cast<uint16_t>(ids.size());
+            groups_.push_back(std::move(group));
+            group_ids.push_back(std::move(ids));
+        }
+        membership_.build(group_ids);
+        return true;
+    }
+
+    bool empty() const { return groups_.empty(); }
+    uint32_t size() const { return static_cast<uint32_t>(groups_.size()); }
+    const Group & group(uint32_t index) const { return groups_[index]; }
+    uint32_t members() const { return membership_.members(); }
+
+    /// Member number of a checkpoint id, NIL if the source is in no group
+    uint32_t member(uint16_t checkpoint_id) const { return membership_.member(checkpoint_id); }
+
+    /// Invoke f(group index) for every group of a member
+    template<typename F>
+    void for_each_group(uint32_t member, F && f) const
+    {
+        membership_.for_each_set(member, [&f](uint32_t group, uint16_t) { f(group); });
+    }
+
+private:
+    std::vector<Group> groups_;
+    SetMembership membership_;
+};
+
+/// Alive members per group, updated with O(1) counter changes per group of a changing member
+/**
+ * Members count as alive from their first heartbeat on, so every group starts unhealthy and
+ * turns healthy once enough members have shown up.
+ */
+class SourceGroupState
+{
+public:
+    void reset(const SourceGroups & groups)
+    {
+        alive_member_.assign(groups.members(), false);
+        alive_.assign(groups.size(), 0);
+    }
+
+    uint16_t alive(uint32_t group) const { return alive_[group]; }
+    bool healthy(const SourceGroups & groups, uint32_t group) const
+    {
+        return alive_[group] >= groups.group(group).required;
+    }
+
+    /// Record that a member came alive or went down
+    /**
+     * f(group) is invoked for every group whose health changed.
+     */
+    template<typename F>
+    void set_alive(const SourceGroups & groups, uint32_t member, bool alive, F && f)
+    {
+        if(alive_member_[member] == alive)
+            return;
+        alive_member_[member] = alive;
+        groups.for_each_group(member, [&](uint32_t group) {
+            const bool was_healthy = healthy(groups, group);
+            alive ? ++alive_[group] : --alive_[group];
+            if(healthy(groups, group) != was_healthy)
+                f(group);
+        });
+    }
+
+private:
+    std::vector<bool> alive_member_;
+    std::vector<uint16_t> alive_;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__SOURCE_GROUPS_HPP_
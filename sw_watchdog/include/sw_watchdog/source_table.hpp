@@ -0,0 +1,536 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__SOURCE_TABLE_HPP_
+#define SW_WATCHDOG__SOURCE_TABLE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "sw_watchdog/flap_damping.hpp"
+#include "sw_watchdog/perfect_hash.hpp"
+#include "sw_watchdog/sharded_counter.hpp"
+
+namespace sw_watchdog
+{
+
+/// Maximum number of sources a health ranking can hold
+constexpr std::size_t MAX_HEALTH_RANKING = 64;
+
+/// Monitoring state of a single heartbeat source (checkpoint)
+/**
+ * Aligned to a cache line so that updates to one source never invalidate the line holding
+ * another source's state. Fields touched on every heartbeat come first.
+ */
+struct alignas(CACHELINE_SIZE) SourceState
+{
+    /// Receive time (node clock) of the most recent heartbeat in nanoseconds
+    int64_t last_seen_ns = 0;
+    /// Receive time by which the next heartbeat is due in nanoseconds
+    int64_t deadline_ns = 0;
+    /// Sender stamp of the most recent heartbeat in nanoseconds
+    int64_t last_stamp_ns = 0;
+    /// Number of heartbeats received from this source
+    uint64_t beats = 0;
+    /// Number of lease expiries attributed to this source
+    uint32_t misses = 0;
+    uint16_t checkpoint_id = 0;
+    uint16_t last_msg_nr = 0;
+    /// Intrusive LRU links (slot indices), also used to chain free slots
+    uint32_t lru_prev = 0;
+    uint32_t lru_next = 0;
+    /// Whether a lease expiry was reported and no heartbeat has been received since
+    bool expired = false;
+    /// Whether the source announced its departure and may be evicted at any time
+    bool departed = false;
+    /// Whether the source currently exceeds its admission rate
+    bool flooding = false;
+
+    /// Admission control: token bucket fill level and time of its last refill
+    float admission_tokens = 0.0f;
+    int64_t admission_refill_ns = 0;
+    /// Number of heartbeats dropped by admission control
+    uint32_t dropped_beats = 0;
+    /// Criticality level, higher levels are processed and reported first
+    uint8_t criticality = 0;
+    /// Flap score of the alive/dead transitions
+    FlapState flap;
+    /// Ensemble members currently considering the source dead, one bit per voter
+    uint8_t votes = 0;
+    /// Whether the votes reached the quorum and the failure has been reported
+    bool quorum_reached = false;
+    /// Lease expiries of the recent past, halved at regular intervals of heartbeats
+    uint16_t recent_misses = 0;
+    /// Position in the health heap, and the key it is ordered by (lower is less healthy)
+    uint32_t heap_pos = 0;
+    int64_t health_key = INT64_MAX;
+    /// Low bits of the progress counter last seen advancing, and when it advanced
+    uint32_t progress = 0;
+    /// Whether the progress counter stands still for longer than the progress timeout
+    bool stuck = false;
+    /// Whether the reported input age exceeds the maximum input age
+    bool stale = false;
+    int64_t progress_ns = 0;
+    /// Smoothed round-trip time of the probe responses and its mean deviation, 0 until the source
+    /// answered a probe
+    uint32_t srtt_ns = 0;
+    uint32_t rttvar_ns = 0;
+};
+static_assert(sizeof(SourceState) % CACHELINE_SIZE == 0,
+              "SourceState has to occupy whole cache lines");
+
+/// Most recent load figures a source sent along with its heartbeats
+/**
+ * Only read when a failure is reported, hence kept apart from the per-heartbeat SourceState.
+ */
+struct SourceLoad
+{
+    /// Whether the source has sent load figures at all
+    bool valid = false;
+    uint16_t cpu_permille = 0;
+    uint32_t loop_time_us = 0;
+    uint32_t queue_depth = 0;
+};
+
+/// Map from checkpoint id to table slot
+/**
+ * Ids below the number of entries it has to hold, as handed out densely by the watchdog's source
+ * registration, index a plain array. Statically configured ids are placed by a minimal perfect
+ * hash, so their lookup is a hash, a load and a key compare. All other ids go to an
+ * open-addressing table with linear probing and backward-shift deletion. Everything is sized
+ * once on reset(), the table to at least twice the number of entries, so lookups, inserts and
+ * erases never allocate.
+ */
+class SlotIndex
+{
+public:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    /// Drop all entries; static_ids are the distinct ids known up front
+    void reset(std::size_t max_entries, const std::vector<uint16_t> & static_ids = {})
+    {
+        std::size_t buckets = 4;
+        while(buckets < 2 * max_entries)
+            buckets <<= 1;
+        buckets_.assign(buckets, Bucket());
+        mask_ = buckets - 1;
+        dense_.assign(max_entries, NIL);
+
+        std::vector<uint16_t> keys;
+        for(const uint16_t checkpoint_id : static_ids)
+            if(checkpoint_id >= max_entries)
+                keys.push_back(checkpoint_id);
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        if(!perfect_.build(keys)) {
+            // Practically impossible; these ids then go to the probing table like all others
+            keys.clear();
+            perfect_.build(keys);
+        }
+        statics_.assign(keys.size(), Bucket());
+        for(const uint16_t checkpoint_id : keys)
+            statics_[perfect_.index(checkpoint_id)].checkpoint_id = checkpoint_id;
+    }
+
+    uint32_t find(uint16_t checkpoint_id) const
+    {
+        if(checkpoint_id < dense_.size())
+            return dense_[checkpoint_id];
+        const uint32_t position = static_position(checkpoint_id);
+        if(position != NIL)
+            return statics_[position].slot;
+        for(std::size_t i = home(checkpoint_id); ; i = (i + 1) & mask_) {
+            const Bucket & bucket = buckets_[i];
+            if(bucket.slot == NIL || bucket.checkpoint_id == checkpoint_id)
+                return bucket.slot;
+        }
+    }
+
+    /// Insert an id that is not yet present
+    void insert(uint16_t checkpoint_id, uint32_t slot)
+    {
+        if(checkpoint_id < dense_.size()) {
+            dense_[checkpoint_id] = slot;
+            return;
+        }
+        const uint32_t position = static_position(checkpoint_id);
+        if(position != NIL) {
+            statics_[position].slot = slot;
+            return;
+        }
+        std::size_t i = home(checkpoint_id);
+        while(buckets_[i].slot != NIL)
+            i = (i + 1) & mask_;
+        buckets_[i].checkpoint_id = checkpoint_id;
+        buckets_[i].slot = slot;
+    }
+
+    void erase(uint16_t checkpoint_id)
+    {
+        if(checkpoint_id < dense_.size()) {
+            dense_[checkpoint_id] = NIL;
+            return;
+        }
+        const uint32_t position = static_position(checkpoint_id);
+        if(position != NIL) {
+            statics_[position].slot = NIL;
+            return;
+        }
+        std::size_t i = home(checkpoint_id);
+        while(buckets_[i].slot != NIL && buckets_[i].checkpoint_id != checkpoint_id)
+            i = (i + 1) & mask_;
+        if(buckets_[i].slot == NIL)
+            return;
+        // Shift following entries of the probe sequence back into the hole
+        std::size_t hole = i;
+        for(std::size_t j = (i + 1) & mask_; buckets_[j].slot != NIL; j = (j + 1) & mask_) {
+            const std::size_t want = home(buckets_[j].checkpoint_id);
+            if(((j - want) & mask_) >= ((j - hole) & mask_)) {
+                buckets_[hole] = buckets_[j];
+                hole = j;
+            }
+        }
+        buckets_[hole] = Bucket();
+    }
+
+private:
+    struct Bucket
+    {
+        uint32_t slot = NIL;
+        uint16_t checkpoint_id = 0;
+    };
+
+    /// Position of a statically configured id, NIL for all other ids
+    uint32_t static_position(uint16_t checkpoint_id) const
+    {
+        if(perfect_.empty())
+            return NIL;
+        const uint32_t position = perfect_.index(checkpoint_id);
+        return statics_[position].checkpoint_id == checkpoint_id ? position : NIL;
+    }
+
+    std::size_t home(uint16_t checkpoint_id) const
+    {
+        // Fibonacci hashing spreads consecutive ids over the table
+        return (static_cast<uint32_t>(checkpoint_id) * 2654435769u >> 8) & mask_;
+    }
+
+    std::vector<Bucket> buckets_;
+    std::size_t mask_ = 0;
+    std::vector<uint32_t> dense_;
+    PerfectHash perfect_;
+    /// Statically configured ids and their slots, each at the perfect hash position of its id
+    std::vector<Bucket> statics_;
+};
+
+/// Fixed-capacity table of per-source monitoring state, keyed by checkpoint id
+/**
+ * All slots are allocated up front, so the memory used by the table is bounded by its capacity
+ * no matter how many sources come and go. Slots are kept on an intrusive LRU list ordered by the
+ * last heartbeat. When the table is full, the least recently heard source is evicted if it has
+ * departed or has been silent for longer than the retention period. Departed sources are moved
+ * to the LRU end right away, so eviction only ever has to look at the tail and is O(1).
+ * Apart from reset(), no member function allocates.
+ */
+class SourceTable
+{
+public:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    explicit SourceTable(std::size_t capacity = 256)
+    {
+        reset(capacity);
+    }
+
+    /// Drop all sources and preallocate room for capacity sources
+    /**
+     * static_ids are the distinct checkpoint ids known up front, they get a collision-free lookup.
+     */
+    void reset(std::size_t capacity, const std::vector<uint16_t> & static_ids = {})
+    {
+        states_.assign(capacity, SourceState());
+        loads_.assign(capacity, SourceLoad());
+        index_.reset(capacity, static_ids);
+        for(std::size_t i = 0; i < capacity; ++i)
+            states_[i].lru_next = (i + 1 < capacity) ? static_cast<uint32_t>(i + 1) : NIL;
+        free_head_ = capacity > 0 ? 0 : NIL;
+        lru_head_ = NIL;
+        lru_tail_ = NIL;
+        heap_.clear();
+        heap_.reserve(capacity);
+        size_ = 0;
+        evictions_ = 0;
+    }
+
+    /// Return the state of the source, or nullptr if it is not in the table
+    SourceState * find(uint16_t checkpoint_id)
+    {
+        const uint32_t slot = index_.find(checkpoint_id);
+        return slot == NIL ? nullptr : &states_[slot];
+    }
+
+    /// Return the state of a source that just sent a heartbeat and mark it most recently used
+    /**
+     * A source seen for the first time gets a fresh slot, evicting the least recently used source
+     * if the table is full. Returns nullptr if the table is full and nothing can be evicted.
+     */
+    SourceState * get_or_insert(uint16_t checkpoint_id, int64_t now_ns, int64_t retention_ns)
+    {
+        const uint32_t found = index_.find(checkpoint_id);
+        if(found != NIL) {
+            move_to_front(found);
+            return &states_[found];
+        }
+        if(free_head_ == NIL) {
+            if(lru_tail_ == NIL || !evictable(states_[lru_tail_], now_ns, retention_ns))
+                return nullptr;
+            evict(lru_tail_);
+        }
+
+        const uint32_t slot = free_head_;
+        free_head_ = states_[slot].lru_next;
+        states_[slot] = SourceState();
+        states_[slot].checkpoint_id = checkpoint_id;
+        loads_[slot] = SourceLoad();
+        index_.insert(checkpoint_id, slot);
+        link_front(slot);
+        heap_push(slot);
+        ++size_;
+        return &states_[slot];
+    }
+
+    /// Slot of a source in the table, in [0, capacity); side arrays of per-source data index by it
+    uint32_t slot(const SourceState & source) const { return slot_of(source); }
+
+    /// Load figures of a source in the table
+    SourceLoad & load(const SourceState & source) { return loads_[slot_of(source)]; }
+    const SourceLoad & load(const SourceState & source) const
+    {
+        return loads_[slot_of(source)];
+    }
+
+    /// Mark a source as gracefully departed, making it the first candidate for eviction
+    void retire(SourceState & source)
+    {
+        source.departed = true;
+        const uint32_t slot = slot_of(source);
+        unlink(slot);
+        link_back(slot);
+    }
+
+    /// Evict departed and long silent sources from the LRU end. Returns the number evicted.
+    std::size_t evict_stale(int64_t now_ns, int64_t retention_ns)
+    {
+        std::size_t evicted = 0;
+        while(lru_tail_ != NIL && evictable(states_[lru_tail_], now_ns, retention_ns)) {
+            evict(lru_tail_);
+            ++evicted;
+        }
+        return evicted;
+    }
+
+    /// Change the health key of a source, O(log n)
+    void update_health(SourceState & source, int64_t key)
+    {
+        const int64_t previous = source.health_key;
+        source.health_key = key;
+        if(key < previous)
+            sift_up(source.heap_pos);
+        else
+            sift_down(source.heap_pos);
+    }
+
+    /// Call f(SourceState &) for up to count sources, least healthy first
+    /**
+     * Walks the health heap in key order, in O(count log count) and without allocating.
+     */
+    template<typename F>
+    void for_each_least_healthy(std::size_t count, F && f)
+    {
+        count = std::min(count, std::min(MAX_HEALTH_RANKING, heap_.size()));
+        // Heap positions that may hold the next least healthy source, as a heap of their own
+        std::array<uint32_t, 2 * MAX_HEALTH_RANKING + 1> frontier;
+        std::size_t frontier_size = 0;
+        const auto healthier = [this](uint32_t a, uint32_t b) {
+            return states_[heap_[a]].health_key > states_[heap_[b]].health_key;
+        };
+        if(count)
+            frontier[frontier_size++] = 0;
+        for(std::size_t i = 0; i < count; ++i) {
+            std::pop_heap(frontier.begin(), frontier.begin() + frontier_size, healthier);
+            const uint32_t position = frontier[--frontier_size];
+            f(states_[heap_[position]]);
+            for(uint32_t child = 2 * position + 1; child <= 2 * position + 2; ++child) {
+                if(child < heap_.size()) {
+                    frontier[frontier_size++] = child;
+                    std::push_heap(frontier.begin(), frontier.begin() + frontier_size, healthier);
+                }
+            }
+        }
+    }
+
+    /// Call f(SourceState &) for every source, most recently heard first
+    template<typename F>
+    void for_each(F && f)
+    {
+        for(uint32_t slot = lru_head_; slot != NIL; slot = states_[slot].lru_next)
+            f(states_[slot]);
+    }
+
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return states_.size(); }
+    /// Number of sources evicted since the last reset
+    uint64_t evictions() const { return evictions_; }
+
+private:
+    static bool evictable(const SourceState & source, int64_t now_ns, int64_t retention_ns)
+    {
+        return source.departed || now_ns - source.last_seen_ns > retention_ns;
+    }
+
+    uint32_t slot_of(const SourceState & source) const
+    {
+        return static_cast<uint32_t>(&source - states_.data());
+    }
+
+    void evict(uint32_t slot)
+    {
+        unlink(slot);
+        heap_remove(slot);
+        index_.erase(states_[slot].checkpoint_id);
+        states_[slot].lru_next = free_head_;
+        free_head_ = slot;
+        --size_;
+        ++evictions_;
+    }
+
+    void heap_push(uint32_t slot)
+    {
+        states_[slot].heap_pos = static_cast<uint32_t>(heap_.size());
+        heap_.push_back(slot);
+        sift_up(states_[slot].heap_pos);
+    }
+
+    void heap_remove(uint32_t slot)
+    {
+        const uint32_t position = states_[slot].heap_pos;
+        const uint32_t last = heap_.back();
+        heap_.pop_back();
+        if(last == slot)
+            return;
+        heap_[position] = last;
+        states_[last].heap_pos = position;
+        sift_up(position);
+        sift_down(states_[last].heap_pos);
+    }
+
+    void heap_swap(uint32_t a, uint32_t b)
+    {
+        std::swap(heap_[a], heap_[b]);
+        states_[heap_[a]].heap_pos = a;
+        states_[heap_[b]].heap_pos = b;
+    }
+
+    void sift_up(uint32_t position)
+    {
+        while(position > 0) {
+            const uint32_t parent = (position - 1) / 2;
+            if(states_[heap_[parent]].health_key <= states_[heap_[position]].health_key)
+                break;
+            heap_swap(parent, position);
+            position = parent;
+        }
+    }
+
+    void sift_down(uint32_t position)
+    {
+        const uint32_t size = static_cast<uint32_t>(heap_.size());
+        while(true) {
+            uint32_t least = position;
+            for(uint32_t child = 2 * position + 1; child <= 2 * position + 2; ++child)
+                if(child < size &&
+                   states_[heap_[child]].health_key < states_[heap_[least]].health_key)
+                    least = child;
+            if(least == position)
+                break;
+            heap_swap(least, position);
+            position = least;
+        }
+    }
+
+    void unlink(uint32_t slot)
+    {
+        SourceState & source = states_[slot];
+        if(source.lru_prev != NIL)
+            states_[source.lru_prev].lru_next = source.lru_next;
+        else
+            lru_head_ = source.lru_next;
+        if(source.lru_next != NIL)
+            states_[source.lru_next].lru_prev = source.lru_prev;
+        else
+            lru_tail_ = source.lru_prev;
+    }
+
+    void link_front(uint32_t slot)
+    {
+        states_[slot].lru_prev = NIL;
+        states_[slot].lru_next = lru_head_;
+        if(lru_head_ != NIL)
+            states_[lru_head_].lru_prev = slot;
+        else
+            lru_tail_ = slot;
+        lru_head_ = slot;
+    }
+
+    void link_back(uint32_t slot)
+    {
+        states_[slot].lru_next = NIL;
+        states_[slot].lru_prev = lru_tail_;
+        if(lru_tail_ != NIL)
+            states_[lru_tail_].lru_next = slot;
+        else
+            lru_head_ = slot;
+        lru_tail_ = slot;
+    }
+
+    void move_to_front(uint32_t slot)
+    {
+        if(slot == lru_head_)
+            return;
+        unlink(slot);
+        link_front(slot);
+    }
+
+    /// Source states, one cache line each, allocated once per reset
+    std::vector<SourceState> states_;
+    /// Load figures per slot of states_
+    std::vector<SourceLoad> loads_;
+    /// Checkpoint id -> slot in states_
+    SlotIndex index_;
+    uint32_t free_head_ = NIL;
+    uint32_t lru_head_ = NIL;
+    uint32_t lru_tail_ = NIL;
+    /// Binary min-heap of slots ordered by health key, preallocated to the capacity
+    std::vector<uint32_t> heap_;
+    std::size_t size_ = 0;
+    uint64_t evictions_ = 0;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__SOURCE_TABLE_HPP_
@@ -0,0 +1,199 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__SYNC_SETS_HPP_
+#define SW_WATCHDOG__SYNC_SETS_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sw_watchdog/source_groups.hpp"
+
+namespace sw_watchdog
+{
+
+/// Reported skew of a member that missed a cycle altogether
+constexpr int64_t SYNC_MISSED = -1;
+
+/// Sets of sources that have to send their heartbeats of a cycle within a bounded skew
+class SyncSets
+{
+public:
+    static constexpr uint32_t NIL = SetMembership::NIL;
+
+    struct Set
+    {
+        std::string name;
+        /// Largest tolerated time between the first and the last arrival of a cycle
+        int64_t max_skew_ns = 0;
+        /// Checkpoint ids of the members, indexed by their position in the set
+        std::vector<uint16_t> ids;
+    };
+
+    /// Build the sets from "<set>:<max skew ms>:<checkpoint id>,<checkpoint id>[,...]" entries
+    bool build(const std::vector<std::string> & entries, std::string * error)
+    {
+        sets_.clear();
+        std::vector<std::vector<uint16_t>> set_ids;
+        for(const std::string & entry : entries) {
+            Set set;
+            long max_skew_ms;
+            if(!parse_source_set(entry, &set.name, &max_skew_ms, &set.ids) || max_skew_ms < 0 ||
+               set.ids.size() < 2 || set.ids.size() > UINT16_MAX) {
+                *error = "malformed entry '" + entry + "', expected <set>:<max skew ms>:"
+                    "<checkpoint id>,<checkpoint id>[,...] with distinct ids";
+                return false;
+            }
+            set.max_skew_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::milliseconds(max_skew_ms)).count();
+            set_ids.push_back(set.ids);
+            sets_.push_back(std::move(set));
+        }
+        membership_.build(set_ids);
+        return true;
+    }
+
+    bool empty() const { return sets_.empty(); }
+    uint32_t size() const { return static_cast<uint32_t>(sets_.size()); }
+    const Set & set(uint32_t index) const { return sets_[index]; }
+    uint32_t members() const { return membership_.members(); }
+
+    /// Member number of a checkpoint id, NIL if the source is in no set
+    uint32_t member(uint16_t checkpoint_id) const { return membership_.member(checkpoint_id); }
+
+    /// Invoke f(set index, position in the set) for every set of a member
+    template<typename F>
+    void for_each_set(uint32_t member, F && f) const
+    {
+        membership_.for_each_set(member, std::forward<F>(f));
+    }
+
+private:
+    std::vector<Set> sets_;
+    SetMembership membership_;
+};
+
+/// Arrival times of the members of each sync set in the current cycle window
+/**
+ * A window opens with the first arrival after the previous one closed and completes once every
+ * member arrived in it; its skew is the time from the opening to the last arrival. A member
+ * arriving a second time closes the window early, reporting the members that did not arrive,
+ * and opens the next one. Cycles are thus told apart by time, not by counting heartbeats, so a
+ * skipped beat is reported once and does not shift the cycles of that member.
+ * A set is armed once all members have been heard from, the next arrival opens the first window.
+ * A member going down disarms its sets until all members are back.
+ */
+class SyncState
+{
+public:
+    void reset(const SyncSets & sets)
+    {
+        windows_.resize(sets.size());
+        for(uint32_t set = 0; set < sets.size(); ++set) {
+            windows_[set].arrivals.resize(sets.set(set).ids.size());
+            disarm(windows_[set]);
+        }
+    }
+
+    /// Record the heartbeat of a member
+    /**
+     * f(set index, position of the last member, skew in nanoseconds) is invoked for every
+     * completed window whose skew exceeds the limit, and with a skew of SYNC_MISSED for every
+     * member missing from a window that had to be closed early.
+     */
+    template<typename F>
+    void arrive(const SyncSets & sets, uint32_t member, int64_t now_ns, F && f)
+    {
+        sets.for_each_set(member, [&](uint32_t set, uint16_t position) {
+            arrive(sets.set(set), set, windows_[set], position, now_ns, f);
+        });
+    }
+
+    /// A member went down: its sets wait for all members again before checking
+    void disarm(const SyncSets & sets, uint32_t member)
+    {
+        sets.for_each_set(member, [this](uint32_t set, uint16_t) { disarm(windows_[set]); });
+    }
+
+private:
+    static constexpr int64_t NOT_ARRIVED = INT64_MIN;
+
+    struct Window
+    {
+        /// Arrival time per member position, NOT_ARRIVED if none yet; while disarmed, whether
+        /// the member has been heard from
+        std::vector<int64_t> arrivals;
+        std::size_t arrived = 0;
+        /// Time of the first arrival of the current window, NOT_ARRIVED if none is open
+        int64_t open_ns = NOT_ARRIVED;
+        bool armed = false;
+    };
+
+    static void clear(Window & window)
+    {
+        std::fill(window.arrivals.begin(), window.arrivals.end(), NOT_ARRIVED);
+        window.arrived = 0;
+        window.open_ns = NOT_ARRIVED;
+    }
+
+    static void disarm(Window & window)
+    {
+        clear(window);
+        window.armed = false;
+    }
+
+    template<typename F>
+    static void arrive(const SyncSets::Set & set, uint32_t index, Window & window,
+                       uint16_t position, int64_t now_ns, F & f)
+    {
+        const std::size_t n = set.ids.size();
+        if(!window.armed) {
+            if(window.arrivals[position] == NOT_ARRIVED)
+                ++window.arrived;
+            window.arrivals[position] = now_ns;
+            if(window.arrived == n) {
+                window.armed = true;
+                clear(window);
+            }
+            return;
+        }
+        if(window.arrivals[position] != NOT_ARRIVED) {
+            // The member is a cycle ahead of those that did not arrive
+            for(std::size_t other = 0; other < n; ++other)
+                if(window.arrivals[other] == NOT_ARRIVED)
+                    f(index, static_cast<uint16_t>(other), SYNC_MISSED);
+            clear(window);
+        }
+        if(window.open_ns == NOT_ARRIVED)
+            window.open_ns = now_ns;
+        window.arrivals[position] = now_ns;
+        if(++window.arrived < n)
+            return;
+        const int64_t skew_ns = now_ns - window.open_ns;
+        if(skew_ns > set.max_skew_ns)
+            f(index, position, skew_ns);
+        clear(window);
+    }
+
+    std::vector<Window> windows_;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__SYNC_SETS_HPP_
@@ -0,0 +1,119 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__TOPIC_AGE_HPP_
+#define SW_WATCHDOG__TOPIC_AGE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace sw_watchdog
+{
+
+/// Newest stamp of a topic that has not delivered a message yet
+constexpr int64_t TOPIC_NO_MESSAGE = std::numeric_limits<int64_t>::min();
+
+/// Limits of a watched topic
+struct TopicAgeLimits
+{
+    /// Maximum age in nanoseconds, 0 if unlimited
+    int64_t max_age_ns = 0;
+    /// Minimum rate, 0 if unlimited
+    double min_rate_hz = 0.0;
+};
+
+/// Statistics of a watched topic in the current report period
+struct TopicAgeState
+{
+    uint32_t messages = 0;
+    /// Header stamp of the newest message received while active
+    int64_t newest_stamp_ns = TOPIC_NO_MESSAGE;
+    int64_t max_age_ns = 0;
+    /// Whether a message of the current period exceeded the maximum age on arrival
+    bool stale = false;
+    /// Whether the newest message exceeded the maximum age at the last report
+    bool silent = false;
+    /// Whether the rate was below the minimum at the last report
+    bool slow = false;
+};
+
+/// Age and rate of a topic over one report period
+struct TopicAgeReport
+{
+    uint32_t messages = 0;
+    float rate_hz = 0.0f;
+    /// Age of the newest message at the time of the report, -1 if none was received
+    int64_t age_ns = -1;
+    int64_t max_age_ns = 0;
+    /// Time since the newest stamp, or since the activation if no message was received
+    int64_t silent_ns = 0;
+    bool stale = false;
+    bool slow = false;
+    /// Whether the topic has fallen silent, or slow, since the previous report
+    bool became_silent = false;
+    bool became_slow = false;
+};
+
+/// Account a message whose header stamp is stamp_ns, arrived at now_ns
+/**
+ * Returns true if the message exceeded the maximum age and is the first to do so in the current
+ * report period.
+ */
+inline bool topic_age_arrival(TopicAgeState & state, const TopicAgeLimits & limits,
+                              int64_t stamp_ns, int64_t now_ns)
+{
+    ++state.messages;
+    const int64_t age_ns = now_ns - stamp_ns;
+    state.newest_stamp_ns = std::max(state.newest_stamp_ns, stamp_ns);
+    state.max_age_ns = std::max(state.max_age_ns, age_ns);
+    if(limits.max_age_ns > 0 && age_ns > limits.max_age_ns && !state.stale) {
+        state.stale = true;
+        return true;
+    }
+    return false;
+}
+
+/// Report the period of period_ns ending at now_ns and start the next one
+/**
+ * The age is that of the newest message at the time of the report, so a silent topic keeps
+ * aging. Until a topic delivers its first message, it is measured from active_since_ns.
+ */
+inline TopicAgeReport topic_age_report(TopicAgeState & state, const TopicAgeLimits & limits,
+                                       int64_t now_ns, int64_t period_ns, int64_t active_since_ns)
+{
+    TopicAgeReport report;
+    report.messages = state.messages;
+    report.rate_hz = period_ns > 0 ?
+        static_cast<float>(state.messages * 1e9 / static_cast<double>(period_ns)) : 0.0f;
+    const bool received = state.newest_stamp_ns != TOPIC_NO_MESSAGE;
+    report.age_ns = received ? now_ns - state.newest_stamp_ns : -1;
+    report.max_age_ns = state.max_age_ns;
+    report.silent_ns = now_ns - (received ? state.newest_stamp_ns : active_since_ns);
+    const bool silent = limits.max_age_ns > 0 && report.silent_ns > limits.max_age_ns;
+    report.became_silent = silent && !state.silent;
+    state.silent = silent;
+    report.stale = state.stale || silent;
+    report.slow = limits.min_rate_hz > 0.0 && report.rate_hz < limits.min_rate_hz;
+    report.became_slow = report.slow && !state.slow;
+    state.slow = report.slow;
+    state.messages = 0;
+    state.max_age_ns = 0;
+    state.stale = false;
+    return report;
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__TOPIC_AGE_HPP_
@@ -0,0 +1,99 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__TOPOLOGY_HPP_
+#define SW_WATCHDOG__TOPOLOGY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace sw_watchdog
+{
+
+/// Host index of sources whose host is unknown
+constexpr uint16_t UNKNOWN_HOST = 0;
+
+/// Correlation state of one host (or container) that runs heartbeat sources
+/**
+ * Expiries of sources with a known host are collected for one lease period, starting at the
+ * first of them. If at least two sources of a host expired in that window and none of its sources
+ * was heard from since the first of these expiries, they are reported together as one unreachable
+ * host. Only sources listed in the topology take part: a source without an entry is reported on
+ * its own, even if its host went away with the others, so correlation needs a topology that
+ * covers every source.
+ */
+struct HostState
+{
+    /// Receive time of the most recent heartbeat of any source on this host
+    int64_t last_beat_ns = 0;
+    /// Receive time of the first expiry in the current window
+    int64_t first_expiry_ns = 0;
+    /// Number of expiries of this host's sources in the current window
+    uint16_t pending = 0;
+    /// Whether the host has already been reported in the current window
+    bool reported = false;
+
+    /// Whether the pending expiries are correlated and share the host as root cause
+    bool unreachable() const { return pending >= 2 && last_beat_ns < first_expiry_ns; }
+};
+
+/// Build the per-id host table from "<checkpoint id>:<host>" entries
+/**
+ * host_of is indexed directly by the checkpoint id and refers into host_names, whose entry
+ * UNKNOWN_HOST is empty. Both stay empty if there are no entries.
+ */
+inline bool parse_topology(const std::vector<std::string> & entries,
+                           std::vector<uint16_t> * host_of, std::vector<std::string> * host_names,
+                           std::string * error)
+{
+    host_of->clear();
+    host_names->clear();
+    if(entries.empty())
+        return true;
+    host_of->assign(UINT16_MAX + 1, UNKNOWN_HOST);
+    host_names->emplace_back();
+    for(const std::string & entry : entries) {
+        const std::size_t colon = entry.find(':');
+        long id = -1;
+        try {
+            if(colon != std::string::npos)
+                id = std::stol(entry.substr(0, colon));
+        } catch(const std::exception &) {
+        }
+        if(id < 0 || id > UINT16_MAX || colon + 1 == entry.size()) {
+            *error = "malformed entry '" + entry + "', expected <checkpoint id>:<host>";
+            return false;
+        }
+        const std::string host = entry.substr(colon + 1);
+        std::size_t index = 1;
+        while(index < host_names->size() && (*host_names)[index] != host)
+            ++index;
+        if(index == host_names->size()) {
+            if(index > UINT16_MAX) {
+                *error = "too many hosts";
+                return false;
+            }
+            host_names->push_back(host);
+        }
+        (*host_of)[id] = static_cast<uint16_t>(index);
+    }
+    return true;
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__TOPOLOGY_HPP_
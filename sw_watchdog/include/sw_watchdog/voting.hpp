@@ -0,0 +1,199 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__VOTING_HPP_
+#define SW_WATCHDOG__VOTING_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sw_watchdog
+{
+
+/// Maximum number of watchdog instances in a voting ensemble, one vote bit each
+constexpr std::size_t MAX_VOTERS = 8;
+/// Vote bit of the local instance
+constexpr uint8_t SELF_VOTE = 1;
+
+/// Assignment of vote bits to the instances of a voting ensemble
+/**
+ * The local instance always holds bit 0, remote voters get the next free bit when their first
+ * verdict arrives. The assignment is local to each instance.
+ */
+class VoterRegistry
+{
+public:
+    explicit VoterRegistry(const std::string & self = std::string())
+    {
+        names_[0] = self;
+        size_ = 1;
+    }
+
+    const std::string & self() const { return names_[0]; }
+    std::size_t size() const { return size_; }
+
+    /// Vote bit of the named voter, assigned on first use; 0 if the ensemble is full
+    uint8_t bit(const std::string & voter)
+    {
+        for(std::size_t i = 0; i < size_; ++i)
+            if(names_[i] == voter)
+                return static_cast<uint8_t>(1u << i);
+        if(size_ == MAX_VOTERS)
+            return 0;
+        names_[size_] = voter;
+        return static_cast<uint8_t>(1u << size_++);
+    }
+
+private:
+    std::array<std::string, MAX_VOTERS> names_;
+    std::size_t size_ = 0;
+};
+
+/// Number of voters in a vote mask
+inline std::size_t vote_count(uint8_t votes)
+{
+    std::size_t count = 0;
+    for(; votes; votes &= static_cast<uint8_t>(votes - 1))
+        ++count;
+    return count;
+}
+
+/// Dead verdicts of other voters that did not yet complete a quorum, and when they arrived
+/**
+ * A verdict that stays alone, because the other voters keep receiving the source, must not
+ * linger: it would count towards an unrelated expiry much later. Votes are kept per slot of the
+ * SourceTable, one receive time per voter, so that recording or revoking a verdict is O(1) even
+ * when a mass expiry brings in a verdict of every voter for every source. Repeated verdicts
+ * refresh the receive time. Room for all slots is reserved once on reset(). A slot that changed
+ * hands, because its source was evicted, drops the votes of its previous source.
+ */
+class PendingVotes
+{
+public:
+    struct Vote
+    {
+        int64_t received_ns;
+        uint16_t checkpoint_id;
+        uint8_t bit;
+    };
+
+    void reset(std::size_t slots)
+    {
+        slots_.assign(slots, Slot());
+        pending_.clear();
+        pending_.reserve(slots);
+        size_ = 0;
+    }
+
+    /// Record a dead verdict of the voter holding bit against the source in slot
+    void add(uint32_t slot, uint16_t checkpoint_id, uint8_t bit, int64_t now_ns)
+    {
+        Slot & votes = slots_[slot];
+        if(votes.bits && votes.checkpoint_id != checkpoint_id)
+            clear(slot);
+        if(!votes.bits) {
+            votes.position = static_cast<uint32_t>(pending_.size());
+            pending_.push_back(slot);
+        }
+        votes.checkpoint_id = checkpoint_id;
+        if(!(votes.bits & bit))
+            ++size_;
+        votes.bits |= bit;
+        votes.received_ns[voter_index(bit)] = now_ns;
+    }
+
+    /// Forget the verdict of the voter holding bit, after it revoked it
+    void remove(uint32_t slot, uint16_t checkpoint_id, uint8_t bit)
+    {
+        Slot & votes = slots_[slot];
+        if(!(votes.bits & bit) || votes.checkpoint_id != checkpoint_id)
+            return;
+        votes.bits &= static_cast<uint8_t>(~bit);
+        --size_;
+        if(!votes.bits)
+            unlink(slot);
+    }
+
+    /// Drop the votes received more than timeout_ns before now_ns, calling f(const Vote &) on each
+    /**
+     * Visits the slots that hold votes only.
+     */
+    template<typename F>
+    void expire(int64_t now_ns, int64_t timeout_ns, F && f)
+    {
+        for(std::size_t i = pending_.size(); i-- > 0; ) {
+            const uint32_t slot = pending_[i];
+            Slot & votes = slots_[slot];
+            for(uint8_t remaining = votes.bits; remaining;
+                remaining &= static_cast<uint8_t>(remaining - 1)) {
+                const uint8_t bit = static_cast<uint8_t>(remaining & -remaining);
+                const int64_t received_ns = votes.received_ns[voter_index(bit)];
+                if(now_ns - received_ns <= timeout_ns)
+                    continue;
+                f(Vote{received_ns, votes.checkpoint_id, bit});
+                votes.bits &= static_cast<uint8_t>(~bit);
+                --size_;
+            }
+            // Unlinking moves the last entry to i, which has been visited already
+            if(!votes.bits)
+                unlink(slot);
+        }
+    }
+
+    /// Number of pending (source, voter) votes
+    std::size_t size() const { return size_; }
+
+private:
+    struct Slot
+    {
+        std::array<int64_t, MAX_VOTERS> received_ns{};
+        uint16_t checkpoint_id = 0;
+        uint8_t bits = 0;
+        /// Position in pending_ while bits is not 0
+        uint32_t position = 0;
+    };
+
+    static std::size_t voter_index(uint8_t bit)
+    {
+        return static_cast<std::size_t>(__builtin_ctz(bit));
+    }
+
+    void clear(uint32_t slot)
+    {
+        size_ -= vote_count(slots_[slot].bits);
+        slots_[slot].bits = 0;
+        unlink(slot);
+    }
+
+    void unlink(uint32_t slot)
+    {
+        const uint32_t position = slots_[slot].position;
+        const uint32_t last = pending_.back();
+        pending_[position] = last;
+        slots_[last].position = position;
+        pending_.pop_back();
+    }
+
+    std::vector<Slot> slots_;
+    /// Slots holding at least one vote
+    std::vector<uint32_t> pending_;
+    std::size_t size_ = 0;
+};
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__VOTING_HPP_
@@ -0,0 +1,296 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SW_WATCHDOG__WATCHDOG_CONFIG_HPP_
+#define SW_WATCHDOG__WATCHDOG_CONFIG_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sw_watchdog/criticality.hpp"
+#include "sw_watchdog/dependencies.hpp"
+#include "sw_watchdog/flap_damping.hpp"
+#include "sw_watchdog/perfect_hash.hpp"
+#include "sw_watchdog/source_groups.hpp"
+#include "sw_watchdog/sync_sets.hpp"
+#include "sw_watchdog/topology.hpp"
+
+namespace sw_watchdog
+{
+
+/// Maximum input age per checkpoint id
+/**
+ * The ids with an explicit limit are placed by a perfect hash, so looking up the limit on every
+ * heartbeat costs about as much as the lease check.
+ */
+struct InputAgeLimits
+{
+    /// Limit of all sources without an explicit one in nanoseconds, 0 if there is none
+    int64_t default_ns = 0;
+    PerfectHash hash;
+    /// Ids with an explicit limit and their limits, at the id's perfect hash position
+    std::vector<uint16_t> ids;
+    std::vector<int64_t> limits_ns;
+
+    /// Maximum input age of a source in nanoseconds, 0 if unlimited
+    int64_t of(uint16_t checkpoint_id) const
+    {
+        if(!ids.empty()) {
+            const uint32_t position = hash.index(checkpoint_id);
+            if(ids[position] == checkpoint_id)
+                return limits_ns[position];
+        }
+        return default_ns;
+    }
+};
+
+/// Runtime configuration of a watchdog
+/**
+ * Held in an RcuCell: a snapshot is never modified after it has been published. To change the
+ * configuration, copy the current snapshot, modify the copy and publish it.
+ */
+struct WatchdogConfig
+{
+    /// The lease duration granted to the remote (heartbeat) publisher
+    std::chrono::milliseconds lease{0};
+    /// The maximum number of lease misses granted to the watched entity
+    uint16_t max_misses = 0;
+    /// Maximum number of sources tracked at the same time (applied on configure)
+    std::size_t max_sources = 256;
+    /// Silence after which a source may be evicted to make room for a new one
+    std::chrono::milliseconds retention{60000};
+    /// Sustained heartbeat rate admitted per source in beats per second, 0 disables admission
+    float admission_rate = 0.0f;
+    /// Number of heartbeats a source may send in a burst above the admission rate
+    float admission_burst = 10.0f;
+    /// Time after activation by which a watched source has to send its first heartbeat, 0 if
+    /// there is no such deadline. Leases are only enforced once the first heartbeat arrived.
+    std::chrono::milliseconds startup_deadline{0};
+    /// Time a reported progress counter may stand still while heartbeats arrive, 0 disables
+    /// progress monitoring
+    std::chrono::milliseconds progress_timeout{0};
+    /// Maximum age of the newest input consumed by a source, checked on every heartbeat that
+    /// reports an input age
+    InputAgeLimits max_input_age;
+    /// Period of the health ranking publication, 0 disables it (applied on activate)
+    std::chrono::milliseconds ranking_period{1000};
+    /// Number of sources in the published health ranking (applied on configure)
+    std::size_t ranking_size = 10;
+    /// Period of the liveness probes for sources that answer probes instead of beating on a timer,
+    /// 0 disables probing (applied on activate). Has to stay below the lease.
+    std::chrono::milliseconds probe_period{0};
+    /// Range of checkpoint ids this watchdog instance is responsible for (applied on activate)
+    uint16_t shard_first = 0;
+    uint16_t shard_last = UINT16_MAX;
+
+    /// Number of ensemble members that have to consider a source dead before it is reported,
+    /// 1 disables voting (applied on configure)
+    uint8_t quorum = 1;
+
+    /// Damping of sources that keep toggling between alive and dead
+    FlapDampingParams flap;
+    /// Criticality level per checkpoint id, indexed directly by the id; empty if all are default
+    std::vector<uint8_t> criticality;
+
+    /// Checkpoint ids that have to appear within the startup deadline (SimpleWatchdog only). Their
+    /// lookup in the source table is collision-free (applied on configure).
+    std::vector<uint16_t> expected_sources;
+    /// Host per checkpoint id, indexed directly by the id and referring into host_names; empty if
+    /// the topology is unknown (host names apply on configure)
+    std::vector<uint16_t> host_of;
+    std::vector<std::string> host_names;
+    /// Dependencies between sources, null if there are none (applied on configure)
+    std::shared_ptr<const DependencyGraph> dependencies;
+    /// Groups of redundant sources with k-of-n health, null if there are none (applied on
+    /// configure)
+    std::shared_ptr<const SourceGroups> groups;
+    /// Sets of sources that have to beat within a bounded skew per cycle, null if there are none
+    /// (applied on configure)
+    std::shared_ptr<const SyncSets> sync_sets;
+
+    uint8_t criticality_of(uint16_t checkpoint_id) const
+    {
+        return criticality.empty() ? 0 : criticality[checkpoint_id];
+    }
+
+    uint16_t host_of_id(uint16_t checkpoint_id) const
+    {
+        return host_of.empty() ? UNKNOWN_HOST : host_of[checkpoint_id];
+    }
+
+    bool voting() const { return quorum > 1; }
+    bool sharded() const { return shard_first != 0 || shard_last != UINT16_MAX; }
+    bool in_shard(uint16_t checkpoint_id) const
+    {
+        return checkpoint_id >= shard_first && checkpoint_id <= shard_last;
+    }
+};
+
+/// Parse "<checkpoint id>:<value>" entries of a string array parameter
+/**
+ * Returns false and fills error on the first malformed entry or out of range checkpoint id.
+ */
+inline bool parse_id_pairs(const std::vector<std::string> & entries,
+                           std::vector<std::pair<uint16_t, long>> * pairs, std::string * error)
+{
+    pairs->clear();
+    for(const std::string & entry : entries) {
+        const std::size_t colon = entry.find(':');
+        try {
+            if(colon == std::string::npos)
+                throw std::invalid_argument("missing ':'");
+            const long id = std::stol(entry.substr(0, colon));
+            const long value = std::stol(entry.substr(colon + 1));
+            if(id < 0 || id > UINT16_MAX)
+                throw std::out_of_range("checkpoint id");
+            pairs->emplace_back(static_cast<uint16_t>(id), value);
+        } catch(const std::exception &) {
+            *error = "malformed entry '" + entry + "', expected <checkpoint id>:<value>";
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Validate the checkpoint ids of an integer array parameter
+inline bool parse_expected_sources(const std::vector<int64_t> & entries,
+                                   std::vector<uint16_t> * ids, std::string * error)
+{
+    ids->clear();
+    for(const int64_t entry : entries) {
+        if(entry < 0 || entry > UINT16_MAX) {
+            *error = "checkpoint id " + std::to_string(entry) + " out of range";
+            return false;
+        }
+        ids->push_back(static_cast<uint16_t>(entry));
+    }
+    return true;
+}
+
+/// Build the per-id criticality table from "<checkpoint id>:<level>" entries
+inline bool parse_criticality(const std::vector<std::string> & entries,
+                              std::vector<uint8_t> * criticality, std::string * error)
+{
+    std::vector<std::pair<uint16_t, long>> pairs;
+    if(!parse_id_pairs(entries, &pairs, error))
+        return false;
+    criticality->clear();
+    if(pairs.empty())
+        return true;
+    criticality->assign(UINT16_MAX + 1, 0);
+    for(const auto & pair : pairs) {
+        if(pair.second < 0 || pair.second >= static_cast<long>(CRITICALITY_LEVELS)) {
+            *error = "criticality level of checkpoint " + std::to_string(pair.first) +
+                " has to be in [0, " + std::to_string(CRITICALITY_LEVELS - 1) + "]";
+            return false;
+        }
+        (*criticality)[pair.first] = static_cast<uint8_t>(pair.second);
+    }
+    return true;
+}
+
+/// Build the per-id input age limits from "<checkpoint id>:<milliseconds>" entries
+inline bool parse_input_age_limits(const std::vector<std::string> & entries,
+                                   InputAgeLimits * limits, std::string * error)
+{
+    std::vector<std::pair<uint16_t, long>> pairs;
+    if(!parse_id_pairs(entries, &pairs, error))
+        return false;
+    std::vector<uint16_t> ids;
+    for(const auto & pair : pairs) {
+        if(pair.second < 0) {
+            *error = "maximum input age of checkpoint " + std::to_string(pair.first) +
+                " must not be negative";
+            return false;
+        }
+        if(std::find(ids.begin(), ids.end(), pair.first) != ids.end()) {
+            *error = "duplicate maximum input age of checkpoint " + std::to_string(pair.first);
+            return false;
+        }
+        ids.push_back(pair.first);
+    }
+    if(!limits->hash.build(ids)) {
+        *error = "cannot build a perfect hash over the checkpoint ids";
+        return false;
+    }
+    limits->ids.assign(ids.size(), 0);
+    limits->limits_ns.assign(ids.size(), 0);
+    for(const auto & pair : pairs) {
+        const uint32_t position = limits->hash.index(pair.first);
+        limits->ids[position] = pair.first;
+        limits->limits_ns[position] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::milliseconds(pair.second)).count();
+    }
+    return true;
+}
+
+/// Build the dependency graph from "<checkpoint id>:<upstream checkpoint id>" entries
+inline bool parse_dependencies(const std::vector<std::string> & entries,
+                               std::shared_ptr<const DependencyGraph> * dependencies,
+                               std::string * error)
+{
+    std::vector<std::pair<uint16_t, long>> pairs;
+    if(!parse_id_pairs(entries, &pairs, error))
+        return false;
+    if(pairs.empty()) {
+        dependencies->reset();
+        return true;
+    }
+    auto graph = std::make_shared<DependencyGraph>();
+    if(!graph->build(pairs, error))
+        return false;
+    *dependencies = std::move(graph);
+    return true;
+}
+
+/// Build the source groups from "<group>:<k>:<checkpoint id>[,<checkpoint id>...]" entries
+inline bool parse_source_groups(const std::vector<std::string> & entries,
+                                std::shared_ptr<const SourceGroups> * groups, std::string * error)
+{
+    if(entries.empty()) {
+        groups->reset();
+        return true;
+    }
+    auto built = std::make_shared<SourceGroups>();
+    if(!built->build(entries, error))
+        return false;
+    *groups = std::move(built);
+    return true;
+}
+
+/// Build the sync sets from "<set>:<max skew ms>:<checkpoint id>,<checkpoint id>[,...]" entries
+inline bool parse_sync_sets(const std::vector<std::string> & entries,
+                            std::shared_ptr<const SyncSets> * sync_sets, std::string * error)
+{
+    if(entries.empty()) {
+        sync_sets->reset();
+        return true;
+    }
+    auto built = std::make_shared<SyncSets>();
+    if(!built->build(entries, error))
+        return false;
+    *sync_sets = std::move(built);
+    return true;
+}
+
+} // namespace sw_watchdog
+
+#endif  // SW_WATCHDOG__WATCHDOG_CONFIG_HPP_
@@ -58,8 +58,10 @@ def generate_launch_description():
         node_namespace='',
         node_name='simple_docker_watchdog',
         output='screen',
-        arguments=['220', '--publish', '--activate']
+        arguments=['220', '--publish', '--activate'],
         #arguments=['__log_level:=debug']
+        # The only watchdog of the system hands out checkpoint ids
+        parameters=[{'registrar': True}]
     )
 
     # Make the Watchdog node take the 'activate' transition
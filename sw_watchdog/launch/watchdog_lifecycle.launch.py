@@ -32,8 +32,10 @@ def generate_launch_description():
         namespace='',
         name='simple_watchdog',
         output='screen',
-        arguments=['220', '--publish', '--activate']
+        arguments=['220', '--publish', '--activate'],
         #arguments=['__log_level:=debug']
+        # The only watchdog of the system hands out checkpoint ids
+        parameters=[{'registrar': True}]
     )
     # When the watchdog reaches the 'inactive' state, log a message
     watchdog_inactive_handler = RegisterEventHandler(
@@ -0,0 +1,45 @@
+# Copyright (c) 2020 Mapless AI, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Launch a heartbeat and three simple watchdogs voting 2-out-of-3 on its failure."""
+
+import launch
+from launch_ros.actions import LifecycleNode
+from launch_ros.actions import Node
+
+def generate_launch_description():
+    set_tty_launch_config_action = launch.actions.SetLaunchConfiguration("emulate_tty", "True")
+    heartbeat_node = Node(
+        package='sw_watchdog',
+        executable='simple_heartbeat',
+        namespace='',
+        name='heartbeat',
+        output='screen',
+        parameters=[{'period': 200}]
+    )
+    # Each watchdog runs in its own process; a failure is only published once two of them agree
+    watchdog_nodes = [
+        LifecycleNode(
+            package='sw_watchdog',
+            executable='simple_watchdog',
+            namespace='',
+            name='simple_watchdog_' + voter,
+            output='screen',
+            arguments=['220', '--publish', '--activate'],
+            # Only one of them hands out checkpoint ids
+            parameters=[{'quorum': 2, 'registrar': voter == 'a'}]
+        )
+        for voter in ['a', 'b', 'c']
+    ]
+    return launch.LaunchDescription([set_tty_launch_config_action, heartbeat_node] + watchdog_nodes)
@@ -0,0 +1,28 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sw_watchdog/executor_progress.hpp"
+
+namespace sw_watchdog
+{
+
+// Defined in the library rather than inline, so the executor and every component loaded into
+// the process share one instance
+ExecutorProgress & executor_progress()
+{
+    static ExecutorProgress progress;
+    return progress;
+}
+
+} // namespace sw_watchdog
@@ -0,0 +1,306 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp/serialized_message.hpp"
+#include "rcutils/cmdline_parser.h"
+#include "rclcpp_components/register_node_macro.hpp"
+
+#include "rclcpp_lifecycle/lifecycle_node.hpp"
+
+// Subscriptions to topics of a type unknown at compile time are available from rclcpp 9
+// (Galactic) on, the node is not built for older versions
+#include "rclcpp/create_generic_subscription.hpp"
+#include "rclcpp/generic_subscription.hpp"
+
+#include "rcutils/logging_macros.h"
+
+#include "sw_watchdog_msgs/msg/topic_ages.hpp"
+#include "sw_watchdog/cdr.hpp"
+#include "sw_watchdog/topic_age.hpp"
+#include "sw_watchdog/visibility_control.h"
+
+using namespace std::chrono_literals;
+
+constexpr char OPTION_AUTO_START[] = "--activate";
+constexpr char TOPIC_AGES_TOPIC_NAME[] = "topic_ages";
+
+namespace {
+
+void print_usage()
+{
+    std::cout <<
+        "Usage: header_age_watchdog [" << OPTION_AUTO_START << "] [-h]\n\n"
+        "Watches the age and rate of messages on the topics given by the 'topics' parameter,\n"
+        "entries <topic>:<type>:<max age ms>[:<min rate hz>]. Every watched type has to start\n"
+        "with a std_msgs/Header.\n\n"
+        "optional arguments:\n"
+        "\t" << OPTION_AUTO_START << ": Start the watchdog on creation.  Defaults to false.\n"
+        "\t-h : Print this help message." <<
+        std::endl;
+}
+
+} // anonymous ns
+
+namespace sw_watchdog
+{
+
+/// HeaderAgeWatchdog inheriting from rclcpp_lifecycle::LifecycleNode
+/**
+ * Watches arbitrary header-bearing topics, such as point clouds or images, without knowing their
+ * types at compile time. Messages are taken in serialized form and only the stamp of their leading
+ * std_msgs/Header is decoded, so the cost per message does not depend on the size of the payload.
+ * Age is the local time minus the header stamp and therefore includes clock offsets between
+ * hosts. A topic falling silent ages on and turns stale as well.
+ */
+class HeaderAgeWatchdog : public rclcpp_lifecycle::LifecycleNode
+{
+public:
+    SW_WATCHDOG_PUBLIC
+    explicit HeaderAgeWatchdog(const rclcpp::NodeOptions& options)
+        : rclcpp_lifecycle::LifecycleNode("header_age_watchdog", options)
+    {
+        // Parse node arguments
+        const std::vector<std::string>& args = this->get_node_options().arguments();
+        std::vector<char *> cargs;
+        cargs.reserve(args.size());
+        for(size_t i = 0; i < args.size(); ++i)
+            cargs.push_back(const_cast<char*>(args[i].c_str()));
+
+        if(!cargs.empty() &&
+           rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), "-h")) {
+            print_usage();
+            std::exit(0);
+        }
+
+        declare_parameter("topics", std::vector<std::string>());
+        declare_parameter("report_period", static_cast<int64_t>(1000));
+
+        if(!cargs.empty() &&
+           rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), OPTION_AUTO_START)) {
+            configure();
+            activate();
+        }
+    }
+
+    /// Account a message of a topic from its serialized form
+    void on_message(std::size_t index, const rclcpp::SerializedMessage & serialized)
+    {
+        Topic & topic = topics_[index];
+        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+        const rcl_serialized_message_t & raw = serialized.get_rcl_serialized_message();
+        int64_t stamp_ns;
+        if(!peek_header_stamp(raw.buffer, raw.buffer_length, &stamp_ns)) {
+            ++topic.age.messages;
+            RCLCPP_WARN_THROTTLE(get_logger(), *get_clock(), 5000,
+                                 "Cannot decode the header of a message on %s",
+                                 topic.name.c_str());
+            return;
+        }
+        // Reported once per report period at most, the flag clears with the next report
+        if(topic_age_arrival(topic.age, topic.limits, stamp_ns, now_ns))
+            RCLCPP_WARN(get_logger(), "Message on %s is %.1f ms old, limit %.1f ms",
+                        topic.name.c_str(), (now_ns - stamp_ns) / 1e6,
+                        topic.limits.max_age_ns / 1e6);
+    }
+
+    /// Publish age and rate of every topic over the last report period and start the next one
+    /**
+     * A silent topic keeps aging, see topic_age_report(). Until a topic delivers its first
+     * message, it is measured from the activation.
+     */
+    void publish_ages()
+    {
+        const rclcpp::Time now = this->get_clock()->now();
+        const int64_t now_ns = now.nanoseconds();
+        const int64_t period_ns = (now - period_start_).nanoseconds();
+        period_start_ = now;
+        ages_msg_.header.stamp = now;
+        for(std::size_t index = 0; index < topics_.size(); ++index) {
+            Topic & topic = topics_[index];
+            const TopicAgeReport report =
+                topic_age_report(topic.age, topic.limits, now_ns, period_ns, active_since_ns_);
+            if(report.became_silent)
+                RCLCPP_WARN(get_logger(), "No message on %s for %.1f ms, limit %.1f ms",
+                            topic.name.c_str(), report.silent_ns / 1e6,
+                            topic.limits.max_age_ns / 1e6);
+            if(report.became_slow)
+                RCLCPP_WARN(get_logger(), "Rate of %s dropped to %.1f Hz, minimum %.1f Hz",
+                            topic.name.c_str(), report.rate_hz, topic.limits.min_rate_hz);
+            sw_watchdog_msgs::msg::TopicAge & age = ages_msg_.topics[index];
+            age.messages = report.messages;
+            age.rate_hz = report.rate_hz;
+            age.age_ns = report.age_ns;
+            age.max_age_ns = report.max_age_ns;
+            age.stale = report.stale;
+            age.slow = report.slow;
+        }
+        ages_pub_->publish(ages_msg_);
+    }
+
+    /// Transition callback for state configuring
+    rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn on_configure(
+        const rclcpp_lifecycle::State &)
+    {
+        topics_.clear();
+        for(const std::string & entry : get_parameter("topics").as_string_array()) {
+            Topic topic;
+            if(!parse_topic(entry, &topic)) {
+                RCLCPP_ERROR(get_logger(), "Invalid topics entry '%s', expected "
+                             "<topic>:<type>:<max age ms>[:<min rate hz>]", entry.c_str());
+                return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+            }
+            topics_.push_back(std::move(topic));
+        }
+        report_period_ = std::chrono::milliseconds(get_parameter("report_period").as_int());
+        if(report_period_.count() <= 0) {
+            RCLCPP_ERROR(get_logger(), "report_period has to be a positive number of milliseconds");
+            return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+        }
+        ages_msg_.topics.resize(topics_.size());
+        for(std::size_t index = 0; index < topics_.size(); ++index)
+            ages_msg_.topics[index].topic = topics_[index].name;
+        ages_pub_ = create_publisher<sw_watchdog_msgs::msg::TopicAges>(TOPIC_AGES_TOPIC_NAME, 1);
+
+        RCUTILS_LOG_INFO_NAMED(get_name(), "on_configure() is called.");
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+    }
+
+    /// Transition callback for state activating
+    rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn on_activate(
+        const rclcpp_lifecycle::State &)
+    {
+        for(std::size_t index = 0; index < topics_.size(); ++index) {
+            Topic & topic = topics_[index];
+            if(topic.subscription)
+                continue;
+            // Best effort readers match both reliable and best effort writers
+            topic.subscription = rclcpp::create_generic_subscription(
+                get_node_topics_interface(), topic.name, topic.type, rclcpp::SensorDataQoS(),
+                [this, index](std::shared_ptr<rclcpp::SerializedMessage> message) -> void {
+                    on_message(index, *message);
+                });
+        }
+        period_start_ = this->get_clock()->now();
+        active_since_ns_ = period_start_.nanoseconds();
+        if(!report_timer_)
+            report_timer_ = create_wall_timer(report_period_,
+                                              std::bind(&HeaderAgeWatchdog::publish_ages, this));
+
+        // Starting from this point, all messages are sent to the network.
+        ages_pub_->on_activate();
+
+        RCUTILS_LOG_INFO_NAMED(get_name(), "on_activate() is called.");
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+    }
+
+    /// Transition callback for state deactivating
+    rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn on_deactivate(
+        const rclcpp_lifecycle::State &)
+    {
+        for(Topic & topic : topics_) {
+            topic.subscription.reset();
+            topic.age = TopicAgeState();
+        }
+        report_timer_.reset();
+
+        // Starting from this point, all messages are no longer sent to the network.
+        ages_pub_->on_deactivate();
+
+        RCUTILS_LOG_INFO_NAMED(get_name(), "on_deactivate() is called.");
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+    }
+
+    /// Transition callback for state cleaningup
+    rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn on_cleanup(
+        const rclcpp_lifecycle::State &)
+    {
+        topics_.clear();
+        ages_pub_.reset();
+        RCUTILS_LOG_INFO_NAMED(get_name(), "on cleanup is called.");
+
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+    }
+
+    /// Transition callback for state shutting down
+    rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn on_shutdown(
+        const rclcpp_lifecycle::State &state)
+    {
+        topics_.clear();
+        report_timer_.reset();
+        ages_pub_.reset();
+
+        RCUTILS_LOG_INFO_NAMED(get_name(), "on shutdown is called from state %s.", state.label().c_str());
+
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+    }
+
+private:
+    /// A watched topic and its statistics in the current report period
+    struct Topic
+    {
+        std::string name;
+        std::string type;
+        TopicAgeLimits limits;
+        std::shared_ptr<rclcpp::SubscriptionBase> subscription;
+        TopicAgeState age;
+    };
+
+    /// Parse a "<topic>:<type>:<max age ms>[:<min rate hz>]" entry
+    static bool parse_topic(const std::string & entry, Topic * topic)
+    {
+        std::vector<std::string> fields;
+        std::size_t begin = 0;
+        for(std::size_t end; (end = entry.find(':', begin)) != std::string::npos; begin = end + 1)
+            fields.push_back(entry.substr(begin, end - begin));
+        fields.push_back(entry.substr(begin));
+        if(fields.size() < 3 || fields.size() > 4 || fields[0].empty() || fields[1].empty())
+            return false;
+        topic->name = fields[0];
+        topic->type = fields[1];
+        try {
+            const long max_age_ms = std::stol(fields[2]);
+            const double min_rate_hz = fields.size() > 3 ? std::stod(fields[3]) : 0.0;
+            if(max_age_ms < 0 || min_rate_hz < 0.0)
+                return false;
+            topic->limits.max_age_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::milliseconds(max_age_ms)).count();
+            topic->limits.min_rate_hz = min_rate_hz;
+        } catch(const std::exception &) {
+            return false;
+        }
+        return true;
+    }
+
+    /// Watched topics, subscribed while active
+    std::vector<Topic> topics_;
+    std::chrono::milliseconds report_period_{1000};
+    rclcpp::TimerBase::SharedPtr report_timer_;
+    rclcpp::Time period_start_;
+    int64_t active_since_ns_ = 0;
+    /// Age and rate of all topics, published once per report period
+    std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sw_watchdog_msgs::msg::TopicAges>> ages_pub_;
+    sw_watchdog_msgs::msg::TopicAges ages_msg_;
+};
+
+} // namespace sw_watchdog
+
+RCLCPP_COMPONENTS_REGISTER_NODE(sw_watchdog::HeaderAgeWatchdog)
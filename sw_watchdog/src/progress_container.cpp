@@ -0,0 +1,36 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/component_manager.hpp"
+
+#include "sw_watchdog/progress_executor.hpp"
+
+/// Component container whose executor reports its progress to the heartbeats loaded into it
+/**
+ * Equivalent to rclcpp_components' component_container, with a ProgressExecutor. SimpleHeartbeat
+ * components with executor_driven set beat from its spin loop.
+ */
+int main(int argc, char * argv[])
+{
+    rclcpp::init(argc, argv);
+    auto executor = std::make_shared<sw_watchdog::ProgressExecutor>();
+    auto node = std::make_shared<rclcpp_components::ComponentManager>(executor);
+    executor->add_node(node);
+    executor->spin();
+    rclcpp::shutdown();
+    return 0;
+}
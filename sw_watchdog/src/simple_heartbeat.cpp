@@ -12,19 +12,35 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <ctime>
 
 #include "rclcpp/rclcpp.hpp"
 #include "rcutils/cmdline_parser.h"
 #include "rclcpp_components/register_node_macro.hpp"
 
+#if __has_include("rclcpp/version.h")
+#include "rclcpp/version.h"
+#endif
+// Callbacks that run before the context shuts down are available from rclcpp 16 (Humble) on
+#if defined(RCLCPP_VERSION_MAJOR) && RCLCPP_VERSION_MAJOR >= 16
+#define SW_WATCHDOG_HAS_PRE_SHUTDOWN
+#endif
+
 #include "sw_watchdog_msgs/msg/heartbeat.hpp"
+#include "sw_watchdog_msgs/msg/probe.hpp"
+#include "sw_watchdog_msgs/srv/register_source.hpp"
+#include "sw_watchdog/checkpoint_ids.hpp"
+#include "sw_watchdog/executor_progress.hpp"
 #include "sw_watchdog/visibility_control.h"
 
 using namespace std::chrono_literals;
 
 constexpr std::chrono::milliseconds LEASE_DELTA = 20ms; ///< Buffer added to heartbeat to define lease.
+constexpr std::chrono::milliseconds REGISTRATION_POLL_PERIOD = 50ms; ///< Retry period of the registration.
 
 namespace
 {
@@ -36,6 +52,16 @@ void print_usage()
         "required arguments:\n"
         "\tperiod: Period in positive integer milliseconds of the heartbeat signal.\n"
         "optional arguments:\n"
+        "\tcheckpoint_id: Fixed checkpoint id in [0, 65535].  Defaults to registration.\n"
+        "\tregistration_timeout: Milliseconds to wait for a checkpoint id from the watchdog's\n"
+        "\t\tregister_source service before deriving one from the node name, 0 to derive\n"
+        "\t\tit right away.  Defaults to 1000.\n"
+        "\tprobed: Answer the watchdog's liveness probes instead of sending heartbeats on a\n"
+        "\t\ttimer; period is then the probe period of the watchdog.  Defaults to false.\n"
+        "\texecutor_driven: Beat from the spin loop of the process' executor and report its\n"
+        "\t\tdispatch progress, when loaded into a progress_container.  Defaults to false.\n"
+        "\tmetrics: Send loop time, CPU share and queue depth along with the heartbeats.\n"
+        "\t\tDefaults to false.\n"
         "\t-h : Print this help message." <<
         std::endl;
 }
@@ -56,9 +82,12 @@ public:
         : Node("simple_heartbeat", options.start_parameter_event_publisher(false).
                                            start_parameter_services(false))
     {   
-        std::srand(std::time(nullptr)); // use current time as seed for random generator
-        test_id = std::rand();
         declare_parameter("period", 10);
+        declare_parameter("checkpoint_id", -1);
+        declare_parameter("registration_timeout", 1000);
+        declare_parameter("probed", false);
+        declare_parameter("executor_driven", false);
+        declare_parameter("metrics", false);
 
         const std::vector<std::string>& args = this->get_node_options().arguments();
         // Parse node arguments
@@ -70,8 +99,18 @@ public:
         }
 
         std::chrono::milliseconds heartbeat_period;
+        int64_t checkpoint_id;
+        std::chrono::milliseconds registration_timeout;
         try {
             heartbeat_period = std::chrono::milliseconds(get_parameter("period").as_int());
+            checkpoint_id = get_parameter("checkpoint_id").as_int();
+            registration_timeout =
+                std::chrono::milliseconds(get_parameter("registration_timeout").as_int());
+            probed_ = get_parameter("probed").as_bool();
+            executor_driven_ = get_parameter("executor_driven").as_bool();
+            metrics_ = get_parameter("metrics").as_bool();
+            if(checkpoint_id > UINT16_MAX)
+                throw std::out_of_range("checkpoint_id");
         } catch (...) {
             print_usage();
             // TODO: Update the rclcpp_components template to be able to handle
@@ -89,30 +128,276 @@ public:
 
         // assert liveliness on the 'heartbeat' topic
         publisher_ = this->create_publisher<sw_watchdog_msgs::msg::Heartbeat>("heartbeat", qos_profile);
-        timer_ = this->create_wall_timer(heartbeat_period,
-                                         std::bind(&SimpleHeartbeat::timer_callback, this));
+        heartbeat_period_ = heartbeat_period;
+        // Heartbeats start once the checkpoint id is known
+        if(checkpoint_id >= 0)
+            start(static_cast<uint16_t>(checkpoint_id));
+        else if(registration_timeout.count() > 0)
+            register_source(registration_timeout);
+        else
+            start(checkpoint_id_from_name(get_fully_qualified_name()));
+#ifdef SW_WATCHDOG_HAS_PRE_SHUTDOWN
+        // rclcpp shuts the context down on SIGINT and SIGTERM before any node is destroyed. This
+        // runs first, while the departure can still reach the network. Older rclcpp only calls
+        // back after the shutdown; there, only the simple_heartbeat executable, which handles the
+        // signals itself, departs on Ctrl-C. In a container the watchdog sees an ordinary expiry.
+        pre_shutdown_handle_ = get_node_base_interface()->get_context()->
+            add_pre_shutdown_callback([this]() { publish_departure(); });
+#endif
+    }
+
+    ~SimpleHeartbeat()
+    {
+#ifdef SW_WATCHDOG_HAS_PRE_SHUTDOWN
+        get_node_base_interface()->get_context()->remove_pre_shutdown_callback(
+            pre_shutdown_handle_);
+#endif
+        if(executor_driven_)
+            executor_progress().remove_beat(this);
+        // Covers unloading the component from a running container and the signal handling of
+        // the simple_heartbeat executable
+        if(rclcpp::ok())
+            publish_departure();
+    }
+
+    /// Record that the application completed work; sent along with the following heartbeats
+    /**
+     * progress has to be non-zero and should advance with every unit of work. A watchdog with a
+     * progress timeout reports the source as stuck if it stands still while heartbeats continue.
+     */
+    void report_progress(uint64_t progress)
+    {
+        progress_.store(progress, std::memory_order_relaxed);
+    }
+
+    /// Record the stamp of the newest input the application consumed
+    /**
+     * The following heartbeats carry the age of this input at the time they are sent, so a
+     * watchdog with a maximum input age can tell when the application acts on stale data.
+     */
+    void report_input(const rclcpp::Time & input_stamp)
+    {
+        input_stamp_ns_.store(input_stamp.nanoseconds(), std::memory_order_relaxed);
+    }
+
+    /// Record the duration of one iteration of the application's processing loop
+    /**
+     * With the metrics parameter set, the following heartbeat carries the longest iteration
+     * recorded since the heartbeat before.
+     */
+    void report_loop_time(std::chrono::nanoseconds loop_time)
+    {
+        const int64_t loop_time_ns = loop_time.count();
+        int64_t longest = loop_time_ns_.load(std::memory_order_relaxed);
+        while(loop_time_ns > longest &&
+              !loop_time_ns_.compare_exchange_weak(longest, loop_time_ns,
+                                                   std::memory_order_relaxed)) {}
+    }
+
+    /// Record the depth of the application's callback or work queue
+    void report_queue_depth(uint32_t depth)
+    {
+        uint32_t deepest = queue_depth_.load(std::memory_order_relaxed);
+        while(depth > deepest &&
+              !queue_depth_.compare_exchange_weak(deepest, depth, std::memory_order_relaxed)) {}
+    }
+
+    /// Tell the watchdog that this source is going away on purpose. Publishes at most once.
+    void publish_departure()
+    {
+        // A source that never sent a heartbeat has nothing to announce
+        if(departed_.exchange(true) || !started_.load())
+            return;
+        if(timer_)
+            timer_->cancel();
+        if(executor_driven_)
+            executor_progress().remove_beat(this);
+        auto message = sw_watchdog_msgs::msg::Heartbeat();
+        rclcpp::Time now = this->get_clock()->now();
+        message.header.stamp = now;
+        message.checkpoint_id = test_id;
+        message.msg_nr = test_cnt.load(std::memory_order_relaxed);
+        message.departing = true;
+        RCLCPP_INFO(this->get_logger(), "Publishing departure, sent at [%f]", now.seconds());
+        publisher_->publish(message);
     }
 
 private:
-    int test_id;
+    /// Obtain a unique checkpoint id from the watchdog, falling back to the name-derived id
+    void register_source(std::chrono::milliseconds timeout)
+    {
+        using RegisterSource = sw_watchdog_msgs::srv::RegisterSource;
+        registration_client_ = create_client<RegisterSource>("register_source");
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        registration_timer_ = create_wall_timer(REGISTRATION_POLL_PERIOD, [this, deadline]() {
+            if(!registration_sent_ && registration_client_->service_is_ready()) {
+                auto request = std::make_shared<RegisterSource::Request>();
+                request->name = get_fully_qualified_name();
+                registration_client_->async_send_request(
+                    request, [this](rclcpp::Client<RegisterSource>::SharedFuture future) {
+                        if(future.get()->success)
+                            start(future.get()->checkpoint_id);
+                        else
+                            registration_sent_ = false; // retry until the deadline
+                    });
+                registration_sent_ = true;
+            }
+            if(std::chrono::steady_clock::now() >= deadline) {
+                RCLCPP_WARN(get_logger(), "Registration timed out, deriving the checkpoint id from "
+                            "the node name");
+                start(checkpoint_id_from_name(get_fully_qualified_name()));
+            }
+        });
+    }
+
+    /// Start sending heartbeats with the given checkpoint id. Only the first call has an effect.
+    void start(uint16_t checkpoint_id)
+    {
+        if(started_.exchange(true))
+            return;
+        if(registration_timer_)
+            registration_timer_->cancel();
+        test_id = checkpoint_id;
+        if(probed_) {
+            // Event-driven sources do no periodic work of their own; the watchdog paces them
+            RCLCPP_INFO(get_logger(), "Answering probes with checkpoint id %u", checkpoint_id);
+            probe_sub_ = create_subscription<sw_watchdog_msgs::msg::Probe>(
+                "watchdog_probe", 1,
+                [this](const sw_watchdog_msgs::msg::Probe::SharedPtr probe) -> void {
+                    if(departed_.load())
+                        return;
+                    advance_msg_nr();
+                    publish_heartbeat(probe->seq);
+                });
+            return;
+        }
+        if(executor_driven_ && executor_progress().attached()) {
+            // A beat then proves that the spin loop, not just one timer of it, moves forward
+            RCLCPP_INFO(get_logger(), "Sending heartbeats with checkpoint id %u from the executor",
+                        checkpoint_id);
+            executor_progress().add_beat(
+                this, heartbeat_period_,
+                [this](const ExecutorProgress::Load & load) {
+                    if(departed_.load())
+                        return;
+                    advance_msg_nr();
+                    publish_heartbeat(0, &load);
+                },
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+            return;
+        }
+        if(executor_driven_)
+            RCLCPP_WARN(get_logger(), "Not spun by a progress_container, falling back to a timer");
+        RCLCPP_INFO(get_logger(), "Sending heartbeats with checkpoint id %u", checkpoint_id);
+        timer_ = this->create_wall_timer(heartbeat_period_,
+                                         std::bind(&SimpleHeartbeat::timer_callback, this));
+    }
+
+    uint16_t test_id = 0;
+
+    /// Count the next heartbeat; only the executor thread beating the source calls this
+    int advance_msg_nr()
+    {
+        const int msg_nr = (test_cnt.load(std::memory_order_relaxed) + 1)%1000;
+        test_cnt.store(msg_nr, std::memory_order_relaxed);
+        return msg_nr;
+    }
+
     void timer_callback()
     {
-        test_cnt = (test_cnt + 1)%1000;
-        if (test_cnt%10 == 0) {
+        if (advance_msg_nr()%10 == 0) {
             RCLCPP_INFO(this->get_logger(), "Skipped cycle");
             return;
         }
+        publish_heartbeat(0);
+    }
+
+    /// Publish a heartbeat, answering probe_seq unless it is 0
+    /**
+     * load is the load of the executor if the heartbeat is executor driven.
+     */
+    void publish_heartbeat(uint32_t probe_seq, const ExecutorProgress::Load * load = nullptr)
+    {
         auto message = sw_watchdog_msgs::msg::Heartbeat();
         rclcpp::Time now = this->get_clock()->now();
         message.header.stamp = now;
         message.checkpoint_id = test_id;
-        message.msg_nr = test_cnt;
+        message.msg_nr = test_cnt.load(std::memory_order_relaxed);
+        message.progress = progress_.load(std::memory_order_relaxed);
+        const int64_t input_stamp_ns = input_stamp_ns_.load(std::memory_order_relaxed);
+        if(input_stamp_ns >= 0)
+            message.input_age_ns = std::max<int64_t>(0, now.nanoseconds() - input_stamp_ns);
+        message.probe_seq = probe_seq;
+        if(load) {
+            message.dispatched = load->dispatched;
+            message.backlog = load->backlog;
+        }
+        if(metrics_)
+            sample_metrics(message.metrics, load);
         RCLCPP_INFO(this->get_logger(), "Publishing heartbeat, sent at [%f]", now.seconds());
         publisher_->publish(message);
     }
+
+    /// Fill the metrics of a heartbeat and start the next sampling interval
+    void sample_metrics(sw_watchdog_msgs::msg::SourceMetrics & metrics,
+                        const ExecutorProgress::Load * load)
+    {
+        int64_t loop_time_ns = loop_time_ns_.exchange(0, std::memory_order_relaxed);
+        uint32_t queue_depth = queue_depth_.exchange(0, std::memory_order_relaxed);
+        if(load) {
+            loop_time_ns = std::max(loop_time_ns, load->loop_time_ns);
+            queue_depth = std::max(queue_depth, load->backlog);
+        }
+        // Two clock reads; the process CPU clock costs about one system call
+        timespec cpu, wall;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+        clock_gettime(CLOCK_MONOTONIC, &wall);
+        const int64_t cpu_ns = cpu.tv_sec * 1000000000LL + cpu.tv_nsec;
+        const int64_t wall_ns = wall.tv_sec * 1000000000LL + wall.tv_nsec;
+        metrics.valid = true;
+        metrics.loop_time_us = static_cast<uint32_t>(
+            std::min<int64_t>(loop_time_ns / 1000, UINT32_MAX));
+        metrics.queue_depth = queue_depth;
+        if(sample_wall_ns_ > 0 && wall_ns > sample_wall_ns_)
+            metrics.cpu_permille = static_cast<uint16_t>(std::min<int64_t>(
+                (cpu_ns - sample_cpu_ns_) * 1000 / (wall_ns - sample_wall_ns_), UINT16_MAX));
+        sample_cpu_ns_ = cpu_ns;
+        sample_wall_ns_ = wall_ns;
+    }
+
     rclcpp::TimerBase::SharedPtr timer_;
+    std::chrono::milliseconds heartbeat_period_;
+    /// Whether heartbeats answer the watchdog's probes instead of following timer_
+    bool probed_ = false;
+    rclcpp::Subscription<sw_watchdog_msgs::msg::Probe>::SharedPtr probe_sub_;
+    /// Whether heartbeats are run by the executor's spin loop instead of timer_
+    bool executor_driven_ = false;
+    /// Whether heartbeats have started, by whichever means
+    std::atomic<bool> started_{false};
+    /// Whether heartbeats carry metrics, the application figures of the current interval and the
+    /// clocks at the previous sample
+    bool metrics_ = false;
+    std::atomic<int64_t> loop_time_ns_{0};
+    std::atomic<uint32_t> queue_depth_{0};
+    int64_t sample_cpu_ns_ = 0;
+    int64_t sample_wall_ns_ = 0;
     rclcpp::Publisher<sw_watchdog_msgs::msg::Heartbeat>::SharedPtr publisher_;
-    int test_cnt = 0;
+    /// Registration with the watchdog while the checkpoint id is not known yet
+    rclcpp::Client<sw_watchdog_msgs::srv::RegisterSource>::SharedPtr registration_client_;
+    rclcpp::TimerBase::SharedPtr registration_timer_;
+    bool registration_sent_ = false;
+    /// Number of the last heartbeat, also read by a departure published from another thread
+    std::atomic<int> test_cnt{0};
+    /// Application progress counter, 0 while the application does not report progress
+    std::atomic<uint64_t> progress_{0};
+    /// Stamp of the newest consumed input, -1 while the application does not report inputs
+    std::atomic<int64_t> input_stamp_ns_{-1};
+    /// Whether the departure heartbeat has been sent
+    std::atomic<bool> departed_{false};
+#ifdef SW_WATCHDOG_HAS_PRE_SHUTDOWN
+    rclcpp::PreShutdownCallbackHandle pre_shutdown_handle_;
+#endif
 };
 
 }  // namespace sw_watchdog
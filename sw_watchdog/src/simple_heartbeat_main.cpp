@@ -0,0 +1,76 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "class_loader/class_loader.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/node_factory.hpp"
+
+/// Standalone SimpleHeartbeat that announces its departure when interrupted
+/**
+ * Equivalent to the executable rclcpp_components generates for a component, except for the
+ * handling of SIGINT and SIGTERM. rclcpp's own handler shuts the context down before any node is
+ * destroyed, and before rclcpp 16 (Humble) nothing runs in between, so the departure heartbeat
+ * could not be published any more. Here a signal only stops the executor; the heartbeat is
+ * destroyed, and publishes its departure, while the context is still valid.
+ */
+int main(int argc, char * argv[])
+{
+    // Block the signals before rclcpp and the middleware start their threads, so that they are
+    // delivered to the waiter below only
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    auto args = rclcpp::init_and_remove_ros_arguments(argc, argv);
+    rclcpp::uninstall_signal_handlers();
+    rclcpp::executors::SingleThreadedExecutor executor;
+    std::atomic<bool> interrupted{false};
+    std::thread waiter([&signals, &executor, &interrupted]() {
+        int signal = 0;
+        sigwait(&signals, &signal);
+        interrupted = true;
+        // Wakes up the executor; a wakeup before it waits is kept until it does
+        executor.cancel();
+    });
+
+    rclcpp::NodeOptions options;
+    options.arguments(args);
+    class_loader::ClassLoader loader(SW_WATCHDOG_LIBRARY);
+    auto factory = loader.createInstance<rclcpp_components::NodeFactory>(
+        "rclcpp_components::NodeFactoryTemplate<sw_watchdog::SimpleHeartbeat>");
+    rclcpp_components::NodeInstanceWrapper heartbeat = factory->create_node_instance(options);
+    executor.add_node(heartbeat.get_node_base_interface());
+    while(rclcpp::ok() && !interrupted.load())
+        executor.spin_once();
+
+    executor.remove_node(heartbeat.get_node_base_interface());
+    // Destroying the heartbeat publishes the departure
+    heartbeat = rclcpp_components::NodeInstanceWrapper();
+    rclcpp::shutdown();
+    // The context was shut down without a signal; wake the waiter up
+    if(!interrupted.load())
+        pthread_kill(waiter.native_handle(), SIGTERM);
+    waiter.join();
+    return 0;
+}
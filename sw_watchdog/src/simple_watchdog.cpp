@@ -12,43 +12,87 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <atomic>
 #include <iostream>
-#include <map>
 
 #include "rclcpp/rclcpp.hpp"
+#include "rclcpp/serialization.hpp"
+#include "rclcpp/serialized_message.hpp"
 #include "rcutils/cmdline_parser.h"
 #include "rclcpp_components/register_node_macro.hpp"
 
 #include "rclcpp_lifecycle/lifecycle_node.hpp"
 
+#if __has_include("rclcpp/version.h")
+#include "rclcpp/version.h"
+#endif
+// Content filtered subscriptions are available from rclcpp 16 (Humble) on
+#if defined(RCLCPP_VERSION_MAJOR) && RCLCPP_VERSION_MAJOR >= 16
+#define SW_WATCHDOG_HAS_CONTENT_FILTER
+#endif
+
 #include "rcutils/logging_macros.h"
 
+#include "sw_watchdog_msgs/msg/group_status.hpp"
+#include "sw_watchdog_msgs/msg/health_ranking.hpp"
 #include "sw_watchdog_msgs/msg/heartbeat.hpp"
+#include "sw_watchdog_msgs/msg/probe.hpp"
 #include "sw_watchdog_msgs/msg/status.hpp"
+#include "sw_watchdog_msgs/msg/verdict.hpp"
+#include "sw_watchdog_msgs/srv/get_health_ranking.hpp"
+#include "sw_watchdog_msgs/srv/register_source.hpp"
+#include "sw_watchdog/admission.hpp"
+#include "sw_watchdog/cdr.hpp"
+#include "sw_watchdog/checkpoint_ids.hpp"
+#include "sw_watchdog/criticality.hpp"
+#include "sw_watchdog/dependencies.hpp"
+#include "sw_watchdog/probing.hpp"
+#include "sw_watchdog/rcu.hpp"
+#include "sw_watchdog/source_groups.hpp"
+#include "sw_watchdog/realtime.hpp"
+#include "sw_watchdog/source_table.hpp"
+#include "sw_watchdog/sync_sets.hpp"
+#include "sw_watchdog/topology.hpp"
 #include "sw_watchdog/visibility_control.h"
-#include "message_filters/subscriber.h"
-#include "message_filters/cache.h"
+#include "sw_watchdog/voting.hpp"
+#include "sw_watchdog/watchdog_config.hpp"
 
 using namespace std::chrono_literals;
 
 constexpr char OPTION_AUTO_START[] = "--activate";
 constexpr char OPTION_PUB_STATUS[] = "--publish";
+constexpr char OPTION_REALTIME[] = "--realtime";
 constexpr char DEFAULT_TOPIC_NAME[] = "heartbeat";
+constexpr char VERDICT_TOPIC_NAME[] = "watchdog_verdict";
+constexpr char REGISTRATION_SERVICE_NAME[] = "register_source";
+constexpr char HEALTH_RANKING_NAME[] = "health_ranking";
+constexpr char GROUP_STATUS_TOPIC_NAME[] = "group_status";
+constexpr char PROBE_TOPIC_NAME[] = "watchdog_probe";
+/// Number of heartbeats after which the recent lease expiries of a source are halved
+constexpr uint64_t RECENT_MISSES_HALVING_BEATS = 64;
+/// Upper bound of heartbeats handled per executor wakeup, so other callbacks are not starved
+constexpr std::size_t MAX_HEARTBEAT_BATCH = 256;
 
 namespace {
 
 void print_usage()
 {
     std::cout <<
-        "Usage: simple_watchdog lease [" << OPTION_AUTO_START << "] [-h]\n\n"
+        "Usage: simple_watchdog lease [" << OPTION_AUTO_START << "] [" << OPTION_PUB_STATUS <<
+        "] [" << OPTION_REALTIME << "] [-h]\n\n"
         "required arguments:\n"
         "\tlease: Lease in positive integer milliseconds granted to the watched entity.\n"
         "optional arguments:\n"
         "\t" << OPTION_AUTO_START << ": Start the watchdog on creation.  Defaults to false.\n"
         "\t" << OPTION_PUB_STATUS << ": Publish lease expiration of the watched entity.  "
         "Defaults to false.\n"
+        "\t" << OPTION_REALTIME << ": Lock memory on configure and keep the active state free of "
+        "allocations and console I/O.  Defaults to false.\n"
+        "\t\tThe whole process is locked, in a component container with all other components\n"
+        "\t\tloaded into it; use a dedicated container or the standalone executable.\n"
         "\t-h : Print this help message." <<
         std::endl;
 }
@@ -70,6 +114,7 @@ public:
     SW_WATCHDOG_PUBLIC
     explicit SimpleWatchdog(const rclcpp::NodeOptions& options)
         : rclcpp_lifecycle::LifecycleNode("simple_watchdog", options),
+          config_(std::make_unique<const WatchdogConfig>()),
           autostart_(false), enable_pub_(false), topic_name_(DEFAULT_TOPIC_NAME), qos_profile_(10)
     {
         // Parse node arguments
@@ -84,19 +129,134 @@ public:
             std::exit(0);
         }
 
-        // Configuration of the Cache
-        heartbeat_cache_sub.subscribe((rclcpp::Node*)this, topic_name_);
-        heartbeat_cache.setCacheSize(25);
-        heartbeat_cache.connectInput(heartbeat_cache_sub);
-        //message_filters::Cache<sw_watchdog_msgs::msg::Heartbeat> heartbeat_cache(heartbeat_cache_sub, 100);
-
         // Lease duration must be >= heartbeat's lease duration
-        lease_duration_ = std::chrono::milliseconds(std::stoul(args[1]));
+        auto config = std::make_unique<WatchdogConfig>();
+        config->lease = std::chrono::milliseconds(std::stoul(args[1]));
+        config->lease = std::chrono::milliseconds(
+            declare_parameter("lease", static_cast<int64_t>(config->lease.count())));
+        config->max_sources = static_cast<std::size_t>(
+            declare_parameter("max_sources", static_cast<int64_t>(config->max_sources)));
+        config->retention = std::chrono::milliseconds(
+            declare_parameter("retention", static_cast<int64_t>(config->retention.count())));
+        config->admission_rate = static_cast<float>(
+            declare_parameter("admission_rate", static_cast<double>(config->admission_rate)));
+        config->admission_burst = static_cast<float>(
+            declare_parameter("admission_burst", static_cast<double>(config->admission_burst)));
+        config->flap.half_life_s = static_cast<float>(
+            declare_parameter("flap_half_life", static_cast<int64_t>(0))) / 1000.0f;
+        config->flap.suppress = static_cast<float>(
+            declare_parameter("flap_suppress", static_cast<double>(config->flap.suppress)));
+        config->flap.reuse = static_cast<float>(
+            declare_parameter("flap_reuse", static_cast<double>(config->flap.reuse)));
+        if(config->flap.reuse >= config->flap.suppress ||
+           config->flap.suppress >= config->flap.ceiling) {
+            // A suppress threshold at the ceiling would never be reached
+            RCLCPP_ERROR(get_logger(), "flap_reuse has to be below flap_suppress, "
+                         "flap_suppress below the flap score ceiling of %.0f",
+                         static_cast<double>(config->flap.ceiling));
+            print_usage();
+            std::exit(-1);
+        }
+        config->startup_deadline = std::chrono::milliseconds(declare_parameter(
+            "startup_deadline", static_cast<int64_t>(config->startup_deadline.count())));
+        config->progress_timeout = std::chrono::milliseconds(declare_parameter(
+            "progress_timeout", static_cast<int64_t>(config->progress_timeout.count())));
+        config->max_input_age.default_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::milliseconds(declare_parameter("max_input_age", static_cast<int64_t>(0))))
+            .count();
+        config->ranking_period = std::chrono::milliseconds(declare_parameter(
+            "ranking_period", static_cast<int64_t>(config->ranking_period.count())));
+        config->ranking_size = static_cast<std::size_t>(
+            declare_parameter("ranking_size", static_cast<int64_t>(config->ranking_size)));
+        config->probe_period = std::chrono::milliseconds(declare_parameter(
+            "probe_period", static_cast<int64_t>(config->probe_period.count())));
+        if(config->probe_period.count() < 0 || config->probe_period >= config->lease) {
+            RCLCPP_ERROR(get_logger(), "probe_period has to be in [0, lease)");
+            print_usage();
+            std::exit(-1);
+        }
+        if(config->ranking_size > MAX_HEALTH_RANKING) {
+            RCLCPP_ERROR(get_logger(), "ranking_size has to be at most %zu", MAX_HEALTH_RANKING);
+            print_usage();
+            std::exit(-1);
+        }
+        std::string error;
+        if(!parse_expected_sources(declare_parameter("expected_sources", std::vector<int64_t>()),
+                                   &config->expected_sources, &error)) {
+            RCLCPP_ERROR(get_logger(), "Invalid expected_sources parameter: %s", error.c_str());
+            print_usage();
+            std::exit(-1);
+        }
+        if(!parse_input_age_limits(
+               declare_parameter("max_input_ages", std::vector<std::string>()),
+               &config->max_input_age, &error)) {
+            RCLCPP_ERROR(get_logger(), "Invalid max_input_ages parameter: %s", error.c_str());
+            print_usage();
+            std::exit(-1);
+        }
+        if(!parse_criticality(declare_parameter("criticality", std::vector<std::string>()),
+                              &config->criticality, &error)) {
+            RCLCPP_ERROR(get_logger(), "Invalid criticality parameter: %s", error.c_str());
+            print_usage();
+            std::exit(-1);
+        }
+        const int64_t shard_first =
+            declare_parameter("shard_first", static_cast<int64_t>(config->shard_first));
+        const int64_t shard_last =
+            declare_parameter("shard_last", static_cast<int64_t>(config->shard_last));
+        if(shard_first < 0 || shard_first > UINT16_MAX || shard_last < 0 ||
+           shard_last > UINT16_MAX || shard_first > shard_last) {
+            RCLCPP_ERROR(get_logger(), "shard_first and shard_last have to be checkpoint ids in "
+                         "[0, 65535], shard_first at most shard_last");
+            print_usage();
+            std::exit(-1);
+        }
+        config->shard_first = static_cast<uint16_t>(shard_first);
+        config->shard_last = static_cast<uint16_t>(shard_last);
+        if(!parse_topology(declare_parameter("topology", std::vector<std::string>()),
+                           &config->host_of, &config->host_names, &error)) {
+            RCLCPP_ERROR(get_logger(), "Invalid topology parameter: %s", error.c_str());
+            print_usage();
+            std::exit(-1);
+        }
+        if(!parse_dependencies(declare_parameter("dependencies", std::vector<std::string>()),
+                               &config->dependencies, &error)) {
+            RCLCPP_ERROR(get_logger(), "Invalid dependencies parameter: %s", error.c_str());
+            print_usage();
+            std::exit(-1);
+        }
+        if(!parse_source_groups(declare_parameter("groups", std::vector<std::string>()),
+                                &config->groups, &error)) {
+            RCLCPP_ERROR(get_logger(), "Invalid groups parameter: %s", error.c_str());
+            print_usage();
+            std::exit(-1);
+        }
+        if(!parse_sync_sets(declare_parameter("sync_sets", std::vector<std::string>()),
+                            &config->sync_sets, &error)) {
+            RCLCPP_ERROR(get_logger(), "Invalid sync_sets parameter: %s", error.c_str());
+            print_usage();
+            std::exit(-1);
+        }
+        const int64_t quorum = declare_parameter("quorum", static_cast<int64_t>(config->quorum));
+        if(quorum < 1 || quorum > static_cast<int64_t>(MAX_VOTERS)) {
+            RCLCPP_ERROR(get_logger(), "quorum has to be in [1, %zu]", MAX_VOTERS);
+            print_usage();
+            std::exit(-1);
+        }
+        config->quorum = static_cast<uint8_t>(quorum);
+        // Only one watchdog per system may hand out checkpoint ids, so it has to be chosen
+        registrar_ = declare_parameter("registrar", false);
+        voters_ = VoterRegistry(declare_parameter("voter", std::string(get_fully_qualified_name())));
+        config_.update(std::move(config));
+        param_cb_handle_ = add_on_set_parameters_callback(
+            std::bind(&SimpleWatchdog::on_set_parameters, this, std::placeholders::_1));
 
         if(rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), OPTION_AUTO_START))
             autostart_ = true;
         if(rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), OPTION_PUB_STATUS))
             enable_pub_ = true;
+        if(rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), OPTION_REALTIME))
+            realtime_ = true;
 
         if(autostart_) {
             configure();
@@ -104,66 +264,960 @@ public:
         }
     }
 
-    void cache_callback(const sw_watchdog_msgs::msg::Heartbeat message)
-    {   
-        //RCLCPP_INFO(get_logger(), "CacheCallback triggert");
-        RCLCPP_INFO(get_logger(), "Put message with ID %d in cache", message.checkpoint_id);
+    /// Validate parameter updates and publish them as a new configuration snapshot
+    rcl_interfaces::msg::SetParametersResult on_set_parameters(
+        const std::vector<rclcpp::Parameter> & parameters)
+    {
+        rcl_interfaces::msg::SetParametersResult result;
+        result.successful = true;
+        auto config = std::make_unique<WatchdogConfig>(*config_.read());
+        for(const rclcpp::Parameter & parameter : parameters) {
+            if(parameter.get_name() == "lease") {
+                if(parameter.as_int() <= 0) {
+                    result.successful = false;
+                    result.reason = "lease has to be a positive number of milliseconds";
+                    return result;
+                }
+                config->lease = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "max_sources") {
+                if(parameter.as_int() <= 0) {
+                    result.successful = false;
+                    result.reason = "max_sources has to be positive";
+                    return result;
+                }
+                config->max_sources = static_cast<std::size_t>(parameter.as_int());
+            } else if(parameter.get_name() == "retention") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "retention must not be negative";
+                    return result;
+                }
+                config->retention = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "admission_rate") {
+                if(parameter.as_double() < 0.0) {
+                    result.successful = false;
+                    result.reason = "admission_rate must not be negative";
+                    return result;
+                }
+                config->admission_rate = static_cast<float>(parameter.as_double());
+            } else if(parameter.get_name() == "admission_burst") {
+                if(parameter.as_double() < 1.0) {
+                    result.successful = false;
+                    result.reason = "admission_burst has to be at least 1";
+                    return result;
+                }
+                config->admission_burst = static_cast<float>(parameter.as_double());
+            } else if(parameter.get_name() == "flap_half_life") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "flap_half_life must not be negative";
+                    return result;
+                }
+                config->flap.half_life_s = static_cast<float>(parameter.as_int()) / 1000.0f;
+            } else if(parameter.get_name() == "flap_suppress") {
+                config->flap.suppress = static_cast<float>(parameter.as_double());
+            } else if(parameter.get_name() == "flap_reuse") {
+                config->flap.reuse = static_cast<float>(parameter.as_double());
+            } else if(parameter.get_name() == "quorum") {
+                if(parameter.as_int() < 1 || parameter.as_int() > static_cast<int64_t>(MAX_VOTERS)) {
+                    result.successful = false;
+                    result.reason = "quorum has to be in [1, " + std::to_string(MAX_VOTERS) + "]";
+                    return result;
+                }
+                config->quorum = static_cast<uint8_t>(parameter.as_int());
+            } else if(parameter.get_name() == "topology") {
+                if(!parse_topology(parameter.as_string_array(), &config->host_of,
+                                   &config->host_names, &result.reason)) {
+                    result.successful = false;
+                    return result;
+                }
+            } else if(parameter.get_name() == "dependencies") {
+                if(!parse_dependencies(parameter.as_string_array(), &config->dependencies,
+                                       &result.reason)) {
+                    result.successful = false;
+                    return result;
+                }
+            } else if(parameter.get_name() == "groups") {
+                if(!parse_source_groups(parameter.as_string_array(), &config->groups,
+                                        &result.reason)) {
+                    result.successful = false;
+                    return result;
+                }
+            } else if(parameter.get_name() == "sync_sets") {
+                if(!parse_sync_sets(parameter.as_string_array(), &config->sync_sets,
+                                    &result.reason)) {
+                    result.successful = false;
+                    return result;
+                }
+            } else if(parameter.get_name() == "startup_deadline") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "startup_deadline must not be negative";
+                    return result;
+                }
+                config->startup_deadline = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "progress_timeout") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "progress_timeout must not be negative";
+                    return result;
+                }
+                config->progress_timeout = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "max_input_age") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "max_input_age must not be negative";
+                    return result;
+                }
+                config->max_input_age.default_ns =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::milliseconds(parameter.as_int())).count();
+            } else if(parameter.get_name() == "max_input_ages") {
+                if(!parse_input_age_limits(parameter.as_string_array(), &config->max_input_age,
+                                           &result.reason)) {
+                    result.successful = false;
+                    return result;
+                }
+            } else if(parameter.get_name() == "ranking_period") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "ranking_period must not be negative";
+                    return result;
+                }
+                config->ranking_period = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "probe_period") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "probe_period must not be negative";
+                    return result;
+                }
+                config->probe_period = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "ranking_size") {
+                if(parameter.as_int() < 0 ||
+                   parameter.as_int() > static_cast<int64_t>(MAX_HEALTH_RANKING)) {
+                    result.successful = false;
+                    result.reason = "ranking_size has to be in [0, " +
+                        std::to_string(MAX_HEALTH_RANKING) + "]";
+                    return result;
+                }
+                config->ranking_size = static_cast<std::size_t>(parameter.as_int());
+            } else if(parameter.get_name() == "expected_sources") {
+                if(!parse_expected_sources(parameter.as_integer_array(), &config->expected_sources,
+                                           &result.reason)) {
+                    result.successful = false;
+                    return result;
+                }
+            } else if(parameter.get_name() == "criticality") {
+                if(!parse_criticality(parameter.as_string_array(), &config->criticality,
+                                      &result.reason)) {
+                    result.successful = false;
+                    return result;
+                }
+            } else if(parameter.get_name() == "shard_first" || parameter.get_name() == "shard_last") {
+                if(parameter.as_int() < 0 || parameter.as_int() > UINT16_MAX) {
+                    result.successful = false;
+                    result.reason = parameter.get_name() + " has to be a checkpoint id in [0, 65535]";
+                    return result;
+                }
+                (parameter.get_name() == "shard_first" ? config->shard_first : config->shard_last) =
+                    static_cast<uint16_t>(parameter.as_int());
+            }
+        }
+        if(config->flap.reuse >= config->flap.suppress) {
+            result.successful = false;
+            result.reason = "flap_reuse has to be below flap_suppress";
+            return result;
+        }
+        if(config->flap.suppress >= config->flap.ceiling) {
+            result.successful = false;
+            result.reason = "flap_suppress has to be below the flap score ceiling of " +
+                            std::to_string(static_cast<int>(config->flap.ceiling));
+            return result;
+        }
+        if(config->shard_first > config->shard_last) {
+            // Both ends may change in one call, hence checked on the result
+            result.successful = false;
+            result.reason = "shard_first has to be at most shard_last";
+            return result;
+        }
+        if(config->probe_period >= config->lease) {
+            // Responses to probes are the heartbeats of probed sources
+            result.successful = false;
+            result.reason = "probe_period has to be below the lease";
+            return result;
+        }
+        // The QoS lease of the subscription, the size of the source table, the set of hosts, the
+        // dependencies, the groups, the sync sets and whether to vote at all only change on the
+        // next configure, the shard filter and the startup deadline on the next activate. The
+        // per-source deadlines use the new lease from the next heartbeat on.
+        config_.update(std::move(config));
+        return result;
+    }
+
+    /// Record a received heartbeat in the state of its source
+    /**
+     * now_ns is the receive time to record; all heartbeats drained in one wakeup share it.
+     */
+    void on_heartbeat(const sw_watchdog_msgs::msg::Heartbeat & message,
+                      const WatchdogConfig & config, int64_t now_ns)
+    {
+        if(registrar_)
+            registry_.reserve(message.checkpoint_id);
+        SourceState * source = sources_.get_or_insert(
+            message.checkpoint_id, now_ns,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config.retention).count());
+        if(!source) {
+            if(!realtime_)
+                RCLCPP_WARN_THROTTLE(get_logger(), *get_clock(), 5000,
+                                     "Source table full (%zu sources), ignoring heartbeat of ID %u",
+                                     sources_.capacity(), message.checkpoint_id);
+            return;
+        }
+        if(config.admission_rate > 0.0f) {
+            const bool was_flooding = source->flooding;
+            if(!admit_heartbeat(*source, config.admission_rate, config.admission_burst, now_ns)) {
+                // Report the offender once when it starts flooding, then drop silently
+                if(!was_flooding && enable_pub_)
+                    publish_failure(*source);
+                return;
+            }
+        }
+        if(source->expired) {
+            // In a voting ensemble, only the quorum reports; a damping notice would bypass it
+            if(config.flap.enabled() && flap_transition(source->flap, config.flap, now_ns) &&
+               enable_pub_ && !voting())
+                publish_failure(*source);
+            if(voting())
+                cast_vote(*source, false, config);
+        }
+        source->last_seen_ns = now_ns;
+        source->deadline_ns = now_ns +
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config.lease).count();
+        source->last_stamp_ns = rclcpp::Time(message.header.stamp).nanoseconds();
+        source->last_msg_nr = message.msg_nr;
+        source->expired = false;
+        source->departed = false;
+        source->criticality = config.criticality_of(message.checkpoint_id);
+        const uint16_t host = config.host_of_id(message.checkpoint_id);
+        if(host < hosts_.size())
+            hosts_[host].last_beat_ns = now_ns;
+        ++source->beats;
+        if(message.progress && config.progress_timeout.count() > 0)
+            check_progress(*source, message.progress, config, now_ns);
+        if(message.input_age_ns >= 0)
+            check_input_age(*source, message.input_age_ns, config);
+        if(message.metrics.valid) {
+            SourceLoad & load = sources_.load(*source);
+            load.valid = true;
+            load.loop_time_us = message.metrics.loop_time_us;
+            load.cpu_permille = message.metrics.cpu_permille;
+            load.queue_depth = message.metrics.queue_depth;
+        }
+        int64_t rtt_ns;
+        if(probe_pub_ && probes_.rtt(message.probe_seq, now_ns, &rtt_ns))
+            update_rtt(source->srtt_ns, source->rttvar_ns, rtt_ns);
+        if(source->beats % RECENT_MISSES_HALVING_BEATS == 0)
+            source->recent_misses >>= 1;
+        // Departed sources are not unhealthy, they leave the ranking
+        sources_.update_health(*source,
+                               message.departing ? INT64_MAX : health_key(*source, config));
+        if(!message.departing)
+            check_sync(message.checkpoint_id, now_ns);
+        // A planned departure starves the downstream sources just like a failure
+        set_source_down(message.checkpoint_id, message.departing);
+        if(message.departing) {
+            // Planned shutdown: the silence that follows is not a lease violation, and the
+            // liveliness loss of its writer does not blame another source
+            ++departures_;
+            last_departure_ns_ = now_ns;
+            if(!realtime_)
+                RCLCPP_INFO(get_logger(), "Source with ID %u departed", message.checkpoint_id);
+            sources_.retire(*source);
+        }
+    }
+
+    /// Flag a source whose heartbeats arrive while its progress counter stands still, O(1)
+    void check_progress(SourceState & source, uint64_t progress, const WatchdogConfig & config,
+                        int64_t now_ns)
+    {
+        const uint32_t low_bits = static_cast<uint32_t>(progress);
+        const int64_t timeout_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config.progress_timeout).count();
+        if(low_bits != source.progress || !source.progress_ns) {
+            source.progress = low_bits;
+            source.progress_ns = now_ns;
+            source.stuck = false;
+        } else if(!source.stuck && now_ns - source.progress_ns >= timeout_ns) {
+            // Report once; the flag clears as soon as the counter moves again
+            source.stuck = true;
+            if(enable_pub_)
+                publish_failure(source);
+        }
+    }
+
+    /// Flag a source that acts on inputs older than its maximum input age, O(1)
+    void check_input_age(SourceState & source, int64_t input_age_ns, const WatchdogConfig & config)
+    {
+        const int64_t limit_ns = config.max_input_age.of(source.checkpoint_id);
+        const bool stale = limit_ns > 0 && input_age_ns > limit_ns;
+        // Report once when the inputs become stale; the flag clears with the first fresh input
+        const bool report = stale && !source.stale;
+        source.stale = stale;
+        if(report && enable_pub_)
+            publish_failure(source);
+    }
+
+    /// Record the arrival of a source in its sync sets and report the members lagging behind
+    void check_sync(uint16_t checkpoint_id, int64_t now_ns)
+    {
+        const uint32_t member = sync_sets_ ? sync_sets_->member(checkpoint_id) : SyncSets::NIL;
+        if(member == SyncSets::NIL)
+            return;
+        sync_state_.arrive(*sync_sets_, member, now_ns,
+                           [this](uint32_t set, uint16_t position, int64_t skew_ns) {
+                               if(enable_pub_)
+                                   publish_sync_violation(sync_sets_->set(set), position, skew_ns);
+                           });
+    }
+
+    /// Queue the heartbeat in batch_[batch_size_] behind the others of its criticality class
+    void stage_heartbeat(const WatchdogConfig & config)
+    {
+        const uint8_t level = config.criticality_of(batch_[batch_size_].checkpoint_id);
+        class_order_[level][class_size_[level]++] = static_cast<uint16_t>(batch_size_++);
+    }
+
+    /// Stage a serialized heartbeat, dropping it unread if it belongs to another shard
+    void stage_serialized_heartbeat(const rclcpp::SerializedMessage & serialized,
+                                    const WatchdogConfig & config)
+    {
+        const rcl_serialized_message_t & raw = serialized.get_rcl_serialized_message();
+        uint16_t checkpoint_id;
+        if(!peek_heartbeat_checkpoint_id(raw.buffer, raw.buffer_length, &checkpoint_id) ||
+           !config.in_shard(checkpoint_id))
+            return;
+        heartbeat_serialization_.deserialize_message(&serialized, &batch_[batch_size_]);
+        stage_heartbeat(config);
+    }
+
+    /// Update the source states of all staged heartbeats, most critical class first
+    /**
+     * Under backlog, a heartbeat of the top class waits at most for the other top-class
+     * heartbeats of the same batch, never for less critical sources.
+     */
+    void process_batch(const WatchdogConfig & config, int64_t now_ns,
+                       std::chrono::steady_clock::time_point wakeup)
+    {
+        for(std::size_t level = CRITICALITY_LEVELS; level-- > 0; ) {
+            for(std::size_t i = 0; i < class_size_[level]; ++i) {
+                on_heartbeat(batch_[class_order_[level][i]], config, now_ns);
+                latencies_[level].record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - wakeup).count());
+            }
+            class_size_[level] = 0;
+        }
+        batch_size_ = 0;
+    }
+
+    /// Handle the dispatched heartbeat and drain all others already queued in the reader
+    /**
+     * One executor dispatch then covers a whole burst of heartbeats: the configuration and the
+     * clock are read once, and the remaining samples are taken directly from the reader.
+     */
+    void drain_heartbeats(const sw_watchdog_msgs::msg::Heartbeat & first)
+    {
+        const auto wakeup = std::chrono::steady_clock::now();
+        const WatchdogConfig * config = config_.read();
+        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+        batch_[0] = first;
+        stage_heartbeat(*config);
+        rclcpp::MessageInfo info;
+        while(batch_size_ < MAX_HEARTBEAT_BATCH && heartbeat_sub_->take(batch_[batch_size_], info))
+            stage_heartbeat(*config);
+        const std::size_t count = batch_size_;
+        process_batch(*config, now_ns, wakeup);
+        if(!realtime_)
+            RCLCPP_INFO(get_logger(), "Watchdog raised by %zu heartbeat(s), first sent at %d seconds",
+                        count, first.header.stamp.sec);
+        config_.quiescent_state();
+    }
+
+    /// Serialized counterpart of drain_heartbeats() used with local shard filtering
+    void drain_serialized_heartbeats(const rclcpp::SerializedMessage & first)
+    {
+        const auto wakeup = std::chrono::steady_clock::now();
+        const WatchdogConfig * config = config_.read();
+        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+        stage_serialized_heartbeat(first, *config);
+        rclcpp::MessageInfo info;
+        for(std::size_t taken = 1;
+            taken < MAX_HEARTBEAT_BATCH && heartbeat_sub_->take_serialized(serialized_msg_, info);
+            ++taken)
+            stage_serialized_heartbeat(serialized_msg_, *config);
+        process_batch(*config, now_ns, wakeup);
+        config_.quiescent_state();
+    }
+
+    /// Subscribe to the heartbeat topic, restricted to the configured checkpoint id range
+    /**
+     * Prefers a content filter evaluated by the middleware, so samples of other shards are not
+     * even delivered. Where the rmw does not support content filtering, samples are taken in
+     * serialized form and rejected on their leading bytes before deserialization.
+     */
+    void create_heartbeat_subscription()
+    {
+        const WatchdogConfig * config = config_.read();
+        rclcpp::SubscriptionOptions options = heartbeat_sub_options_;
+#ifdef SW_WATCHDOG_HAS_CONTENT_FILTER
+        if(config->sharded()) {
+            options.content_filter_options.filter_expression =
+                "checkpoint_id >= %0 AND checkpoint_id <= %1";
+            options.content_filter_options.expression_parameters = {
+                std::to_string(config->shard_first), std::to_string(config->shard_last)};
+        }
+#endif
+        if(!config->sharded() || content_filter_supported_) {
+            heartbeat_sub_ = create_subscription<sw_watchdog_msgs::msg::Heartbeat>(
+                topic_name_,
+                qos_profile_,
+                [this](const typename sw_watchdog_msgs::msg::Heartbeat::SharedPtr msg) -> void {
+                    drain_heartbeats(*msg);
+                },
+                options);
+#ifdef SW_WATCHDOG_HAS_CONTENT_FILTER
+            if(!config->sharded() || heartbeat_sub_->is_cft_enabled())
+                return;
+            RCLCPP_WARN(get_logger(), "rmw does not support content filtering, filtering locally");
+            content_filter_supported_ = false;
+            heartbeat_sub_.reset();
+#else
+            return;
+#endif
+        }
+        heartbeat_sub_ = create_subscription<sw_watchdog_msgs::msg::Heartbeat>(
+            topic_name_,
+            qos_profile_,
+            [this](const std::shared_ptr<rclcpp::SerializedMessage> serialized) -> void {
+                drain_serialized_heartbeats(*serialized);
+            },
+            heartbeat_sub_options_);
+    }
+
+    /// Find the source that let its lease expire, nullptr if no source is overdue
+    /**
+     * Among the overdue sources, the most critical one is reported first. The liveliness event can
+     * precede the local deadline, as the writer's lease is shorter than the lease of this watchdog,
+     * and it also covers the writers of other shards. Only an overdue source is ever blamed.
+     */
+    SourceState * find_expired_source()
+    {
+        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+        SourceState * oldest = nullptr;
+        sources_.for_each([&oldest, now_ns](SourceState & source) {
+            if(source.expired || source.departed || source.deadline_ns > now_ns)
+                return;
+            if(!oldest || source.criticality > oldest->criticality ||
+               (source.criticality == oldest->criticality &&
+                source.deadline_ns < oldest->deadline_ns))
+                oldest = &source;
+        });
+        if(!oldest)
+            return nullptr;
+        oldest->expired = true;
+        ++oldest->misses;
+        if(oldest->recent_misses < UINT16_MAX)
+            ++oldest->recent_misses;
+        sources_.update_health(*oldest, health_key(*oldest, *config_.read()));
+        return oldest;
+    }
+
+    /// Attribute a liveliness loss to an overdue source, or hold it back until one is overdue
+    /**
+     * A loss that follows a planned departure is the departed writer going away and is consumed.
+     */
+    void on_liveliness_lost()
+    {
+        SourceState * source = find_expired_source();
+        if(source) {
+            report_expiry(*source);
+            return;
+        }
+        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+        const int64_t lease_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config_.read()->lease).count();
+        if(departures_ && now_ns - last_departure_ns_ <= lease_ns) {
+            --departures_;
+            return;
+        }
+        departures_ = 0;
+        ++unattributed_losses_;
+        last_loss_ns_ = now_ns;
+        if(attribution_timer_ && attribution_timer_->is_canceled())
+            attribution_timer_->reset();
+    }
+
+    /// Report the sources that became overdue since their liveliness loss was held back
+    /**
+     * Every live source is due within a lease, so a loss still unattributed a lease after the
+     * last one was a writer that recovered, or one of another shard, and is dropped.
+     */
+    void attribute_losses()
+    {
+        SourceState * source;
+        while(unattributed_losses_ && (source = find_expired_source())) {
+            --unattributed_losses_;
+            report_expiry(*source);
+        }
+        const int64_t lease_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config_.read()->lease).count();
+        if(this->get_clock()->now().nanoseconds() - last_loss_ns_ > lease_ns)
+            unattributed_losses_ = 0;
+        if(!unattributed_losses_)
+            attribution_timer_->cancel();
+        config_.quiescent_state();
+    }
+
+    /// Health ranking key of a source: the time its next heartbeat is due, brought forward by one
+    /// lease per recent lease expiry. It only changes on events of the source itself.
+    static int64_t health_key(const SourceState & source, const WatchdogConfig & config)
+    {
+        const int64_t lease_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config.lease).count();
+        return source.deadline_ns - lease_ns * source.recent_misses;
+    }
+
+    /// Fill a ranking with the count least healthy sources, reusing the capacity of its sources
+    void fill_ranking(sw_watchdog_msgs::msg::HealthRanking & ranking, std::size_t count)
+    {
+        const rclcpp::Time now = this->get_clock()->now();
+        ranking.header.stamp = now;
+        ranking.sources.clear();
+        sources_.for_each_least_healthy(count, [&ranking, &now](const SourceState & source) {
+            ranking.sources.emplace_back();
+            sw_watchdog_msgs::msg::SourceHealth & health = ranking.sources.back();
+            health.checkpoint_id = source.checkpoint_id;
+            health.silence_ns = now.nanoseconds() - source.last_seen_ns;
+            health.recent_misses = source.recent_misses;
+            health.expired = source.expired;
+            health.srtt_ns = source.srtt_ns;
+            health.rttvar_ns = source.rttvar_ns;
+        });
+    }
+
+    /// Publish the least healthy sources
+    void publish_ranking()
+    {
+        // Stay within the capacity reserved on configure
+        const std::size_t count =
+            std::min(config_.read()->ranking_size, ranking_msg_.sources.capacity());
+        config_.quiescent_state();
+        fill_ranking(ranking_msg_, count);
+        ranking_pub_->publish(ranking_msg_);
+    }
+
+    /// Send the next liveness probe; probed sources answer it with a heartbeat
+    void send_probe()
+    {
+        const rclcpp::Time now = this->get_clock()->now();
+        probe_msg_.header.stamp = now;
+        probe_msg_.seq = probes_.send(now.nanoseconds());
+        probe_pub_->publish(probe_msg_);
     }
-    
-    bool check_messages_in_cache(sw_watchdog_msgs::msg::Heartbeat* lost_message){
-        auto messages_in_cache = heartbeat_cache.getInterval(heartbeat_cache.getOldestTime(), heartbeat_cache.getLatestTime());
-        std::map<int, std::vector<sw_watchdog_msgs::msg::Heartbeat>> node_id_list;
-        for (std::shared_ptr<const sw_watchdog_msgs::msg::Heartbeat> message : messages_in_cache){
-            if (node_id_list.count(message->checkpoint_id)==0){
-                std::vector<sw_watchdog_msgs::msg::Heartbeat> msg_vec;
-                msg_vec.push_back(*message);
-                node_id_list.insert({message->checkpoint_id, msg_vec});
+
+    /// Answer a query for the least healthy sources
+    void on_get_health_ranking(
+        const std::shared_ptr<sw_watchdog_msgs::srv::GetHealthRanking::Request> request,
+        std::shared_ptr<sw_watchdog_msgs::srv::GetHealthRanking::Response> response)
+    {
+        fill_ranking(response->ranking, request->count);
+    }
+
+    /// Fill a status message with the state of a source
+    void fill_status(sw_watchdog_msgs::msg::Status & msg, const SourceState & source)
+    {
+        msg.missed_number = source.checkpoint_id;
+        msg.checkpoint_id = source.checkpoint_id;
+        msg.flooding = source.flooding;
+        msg.dropped_beats = source.dropped_beats;
+        msg.unstable = source.flap.damped;
+        msg.stuck = source.stuck;
+        msg.stale = source.stale;
+        // Sources are only tracked from their first heartbeat on
+        msg.absent = source.beats == 0;
+        msg.sync_set.clear();
+        msg.skew_ns = 0;
+        // Sources reported before their first heartbeat are not in the table
+        const SourceLoad * load =
+            sources_.find(source.checkpoint_id) == &source ? &sources_.load(source) : nullptr;
+        msg.metrics.valid = load && load->valid;
+        msg.metrics.loop_time_us = msg.metrics.valid ? load->loop_time_us : 0;
+        msg.metrics.cpu_permille = msg.metrics.valid ? load->cpu_permille : 0;
+        msg.metrics.queue_depth = msg.metrics.valid ? load->queue_depth : 0;
+    }
+
+    /// Report the expected sources of this shard that did not appear within the startup deadline
+    void check_startup()
+    {
+        startup_timer_->cancel();
+        const WatchdogConfig * config = config_.read();
+        for(const uint16_t checkpoint_id : config->expected_sources) {
+            if(!config->in_shard(checkpoint_id) || sources_.find(checkpoint_id))
+                continue;
+            SourceState absent;
+            absent.checkpoint_id = checkpoint_id;
+            if(enable_pub_)
+                publish_failure(absent);
+        }
+        config_.quiescent_state();
+    }
+
+    /// Record a lease expiry of a source and publish it unless the source is damped
+    void report_expiry(SourceState & source)
+    {
+        const WatchdogConfig * config = config_.read();
+        const bool is_consequential = consequential(source);
+        set_source_down(source.checkpoint_id, true);
+        if(is_consequential) {
+            // Only root causes are reported; this one follows once its upstream sources are back
+            if(!realtime_)
+                RCLCPP_INFO(get_logger(), "Suppressing consequential failure of ID %u",
+                            source.checkpoint_id);
+            return;
+        }
+        if(config->flap.enabled()) {
+            const int64_t now_ns = this->get_clock()->now().nanoseconds();
+            const bool became_damped = flap_transition(source.flap, config->flap, now_ns);
+            // A damped source is reported once as unstable, then its transitions are suppressed
+            if(source.flap.damped && !became_damped)
+                return;
+        }
+        // Hold back expiries of sources with a known host until the window of the host closes
+        const uint16_t host = config->host_of_id(source.checkpoint_id);
+        if(host != UNKNOWN_HOST && host < hosts_.size() && correlation_timer_ &&
+           pending_expiries_.size() < pending_expiries_.capacity()) {
+            HostState & state = hosts_[host];
+            if(!state.pending++)
+                state.first_expiry_ns = this->get_clock()->now().nanoseconds();
+            pending_expiries_.push_back(source.checkpoint_id);
+            return;
+        }
+        declare_dead(source, *config);
+    }
+
+    /// Warn about expected sources that the topology does not place on a host
+    /**
+     * Their expiries are never correlated; when their host goes away, they are reported one by
+     * one next to the report of the host.
+     */
+    void warn_unplaced_sources(const WatchdogConfig & config)
+    {
+        constexpr std::size_t LISTED = 8;
+        std::size_t unplaced = 0;
+        std::string listed;
+        for(const uint16_t checkpoint_id : config.expected_sources) {
+            if(config.host_of_id(checkpoint_id) != UNKNOWN_HOST)
+                continue;
+            if(unplaced++ < LISTED)
+                listed += (listed.empty() ? "" : ", ") + std::to_string(checkpoint_id);
+        }
+        if(unplaced)
+            RCLCPP_WARN(get_logger(), "%zu expected source(s) without a topology entry are not "
+                        "correlated by host: %s%s", unplaced, listed.c_str(),
+                        unplaced > LISTED ? ", ..." : "");
+    }
+
+    /// Report the expiries of hosts whose window closed by now_ns, one report per unreachable host
+    /**
+     * The window of a host closes a lease after its first held back expiry, so no expiry waits
+     * longer than a lease plus the timer period. Expiries of hosts with an open window are kept.
+     */
+    void correlate_expiries(int64_t now_ns)
+    {
+        const WatchdogConfig * config = config_.read();
+        const int64_t lease_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config->lease).count();
+        const auto closed = [now_ns, lease_ns](const HostState & state) {
+            return state.pending && state.first_expiry_ns <= now_ns - lease_ns;
+        };
+        std::size_t kept = 0;
+        for(const uint16_t checkpoint_id : pending_expiries_) {
+            const uint16_t host = config->host_of_id(checkpoint_id);
+            if(host < hosts_.size() && !closed(hosts_[host])) {
+                pending_expiries_[kept++] = checkpoint_id;
+                continue;
             }
-            else{
-                node_id_list.at(message->checkpoint_id).push_back(*message);
+            SourceState * source = sources_.find(checkpoint_id);
+            if(host >= hosts_.size() || !source || !source->expired)
+                continue; // recovered or evicted in the meantime
+            HostState & state = hosts_[host];
+            if(!state.unreachable()) {
+                declare_dead(*source, *config);
+            } else if(!state.reported) {
+                state.reported = true;
+                if(enable_pub_)
+                    publish_failure(*source, &config->host_names[host], state.pending);
             }
         }
-        std::map<int, uint64_t> node_avg_time_inervall_map;
-        for (std::pair<const int, std::vector<sw_watchdog_msgs::msg::Heartbeat>> node_and_msgs_in_cache : node_id_list){
-            std::vector<uint64_t> intervall_between_msgs;
-            size_t i = 1;
-            while(i<node_and_msgs_in_cache.second.size()){
-                intervall_between_msgs.push_back(
-                    // Check if uint64_t is large enough
-                    (node_and_msgs_in_cache.second[i].header.stamp.sec-node_and_msgs_in_cache.second[i].header.stamp.sec)*1000000000 +
-                    (node_and_msgs_in_cache.second[i-1].header.stamp.nanosec-node_and_msgs_in_cache.second[i-1].header.stamp.nanosec)
-                    );
-                i++;
+        pending_expiries_.resize(kept);
+        for(HostState & state : hosts_) {
+            if(closed(state)) {
+                state.pending = 0;
+                state.reported = false;
             }
-            // Check if a special treatment is required for the case that only one message for a id is in cache
-            uint64_t avg_intervall_between_msgs = std::accumulate(intervall_between_msgs.begin(), intervall_between_msgs.end(), 0.0) / intervall_between_msgs.size();
-            node_avg_time_inervall_map.insert({node_and_msgs_in_cache.first, avg_intervall_between_msgs});
         }
-        std::pair<const int, uint64_t> result = std::pair<const int, uint64_t>(-1, 10000000000);
-        rclcpp::Time now = this->get_clock()->now();
-        for (std::pair<const int, uint64_t> node_intervall_pair : node_avg_time_inervall_map){
-            uint64_t diff_last_msg_to_now =
-                (now.seconds() - node_id_list.at(node_intervall_pair.first).back().header.stamp.sec)*1000000000 +
-                (now.seconds() - node_id_list.at(node_intervall_pair.first).back().header.stamp.sec);
-            if(diff_last_msg_to_now < result.second){     
-                // Warning here that the parameter is not used   
-                std::pair<const int, uint64_t> result = std::pair<const int, uint64_t>(node_intervall_pair.first, diff_last_msg_to_now);
+        config_.quiescent_state();
+    }
+
+    /// Track the liveness of a source in its groups, its sync sets and the dependency graph
+    /**
+     * A source coming back may turn the failures of its downstream sources into root causes,
+     * these are reported now.
+     */
+    void set_source_down(uint16_t checkpoint_id, bool down)
+    {
+        const uint32_t member = groups_ ? groups_->member(checkpoint_id) : SourceGroups::NIL;
+        if(member != SourceGroups::NIL)
+            group_state_.set_alive(*groups_, member, !down, [this](uint32_t group) {
+                publish_group_status(group);
+            });
+        const uint32_t sync_member =
+            down && sync_sets_ ? sync_sets_->member(checkpoint_id) : SyncSets::NIL;
+        if(sync_member != SyncSets::NIL)
+            sync_state_.disarm(*sync_sets_, sync_member);
+        const uint32_t node =
+            dependencies_ ? dependencies_->node(checkpoint_id) : DependencyGraph::NIL;
+        if(node == DependencyGraph::NIL)
+            return;
+        dependency_state_.set_down(*dependencies_, node, down, [this](uint32_t child) {
+            SourceState * source = sources_.find(dependencies_->id(child));
+            if(source && source->expired && !source->departed)
+                declare_dead(*source, *config_.read());
+        });
+    }
+
+    /// Publish the health of a group after it changed
+    void publish_group_status(uint32_t group)
+    {
+        const SourceGroups::Group & config = groups_->group(group);
+        const bool healthy = group_state_.healthy(*groups_, group);
+        if(!realtime_)
+            RCLCPP_INFO(get_logger(), "Group %s %s (%u of %u members alive, %u required)",
+                        config.name.c_str(), healthy ? "healthy" : "unhealthy",
+                        group_state_.alive(group), config.members, config.required);
+        // The name fits into the capacity reserved on configure
+        group_status_msg_.header.stamp = this->get_clock()->now();
+        group_status_msg_.group.assign(config.name);
+        group_status_msg_.healthy = healthy;
+        group_status_msg_.alive = group_state_.alive(group);
+        group_status_msg_.required = config.required;
+        group_status_msg_.members = config.members;
+        group_status_pub_->publish(group_status_msg_);
+    }
+
+    /// Whether the failure of a source is the consequence of a dead upstream source
+    bool consequential(const SourceState & source)
+    {
+        const uint32_t node =
+            dependencies_ ? dependencies_->node(source.checkpoint_id) : DependencyGraph::NIL;
+        if(node == DependencyGraph::NIL)
+            return false;
+        if(dependency_state_.consequential(node))
+            return true;
+        // The downstream source may be blamed before its overdue upstream source. Such an upstream
+        // source is dead as well; marking it lets its recovery unmask this failure.
+        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+        bool overdue = false;
+        dependencies_->for_each_upstream(node, [&](uint32_t parent) {
+            const SourceState * upstream = sources_.find(dependencies_->id(parent));
+            if(upstream && !upstream->expired && !upstream->departed &&
+               upstream->deadline_ns <= now_ns) {
+                dependency_state_.set_down(*dependencies_, parent, true, [](uint32_t) {});
+                overdue = true;
+            }
+        });
+        return overdue;
+    }
+
+    /// Report a dead source, or vote on it if this instance is part of a voting ensemble
+    void declare_dead(SourceState & source, const WatchdogConfig & config)
+    {
+        if(voting())
+            cast_vote(source, true, config);
+        else if(enable_pub_)
+            publish_failure(source);
+    }
+
+    /// Whether this instance is part of a voting ensemble, decided on configure
+    bool voting() const { return static_cast<bool>(verdict_pub_); }
+
+    /// Share the local verdict about a source with the ensemble and count it
+    void cast_vote(SourceState & source, bool dead, const WatchdogConfig & config)
+    {
+        if(dead)
+            source.votes |= SELF_VOTE;
+        else
+            source.votes &= static_cast<uint8_t>(~SELF_VOTE);
+        verdict_msg_.header.stamp = this->get_clock()->now();
+        verdict_msg_.checkpoint_id = source.checkpoint_id;
+        verdict_msg_.dead = dead;
+        verdict_pub_->publish(verdict_msg_);
+        tally_votes(source, config);
+    }
+
+    /// Report the failure of a source once the votes against it reach the quorum
+    void tally_votes(SourceState & source, const WatchdogConfig & config)
+    {
+        const bool reached = vote_count(source.votes) >= config.quorum;
+        if(reached && !source.quorum_reached && enable_pub_)
+            publish_failure(source);
+        source.quorum_reached = reached;
+    }
+
+    /// Hand out a unique checkpoint id to a registering source
+    void on_register_source(
+        const std::shared_ptr<sw_watchdog_msgs::srv::RegisterSource::Request> request,
+        std::shared_ptr<sw_watchdog_msgs::srv::RegisterSource::Response> response)
+    {
+        // Running sources get a lease to announce the ids they hold before new ones are handed out
+        if(this->get_clock()->now().nanoseconds() < registration_open_ns_) {
+            response->success = false;
+            return;
+        }
+        response->success = registry_.assign(request->name, &response->checkpoint_id);
+        if(!response->success && !realtime_)
+            RCLCPP_WARN(get_logger(), "No checkpoint id left for source %s", request->name.c_str());
+        else if(!realtime_)
+            RCLCPP_INFO(get_logger(), "Source %s registered with ID %u", request->name.c_str(),
+                        response->checkpoint_id);
+    }
+
+    /// Count the verdict of another ensemble member
+    void on_verdict(const sw_watchdog_msgs::msg::Verdict & msg)
+    {
+        if(msg.voter == voters_.self())
+            return;
+        const uint8_t bit = voters_.bit(msg.voter);
+        if(!bit) {
+            if(!realtime_)
+                RCLCPP_WARN_THROTTLE(get_logger(), *get_clock(), 5000,
+                                     "More than %zu voters, ignoring verdict of %s",
+                                     MAX_VOTERS, msg.voter.c_str());
+            return;
+        }
+        // Sources this instance never heard of cannot be confirmed dead by it either
+        SourceState * source = sources_.find(msg.checkpoint_id);
+        if(source) {
+            if(msg.dead) {
+                source->votes |= bit;
+                pending_votes_.add(sources_.slot(*source), msg.checkpoint_id, bit,
+                                   this->get_clock()->now().nanoseconds());
+            } else {
+                source->votes &= static_cast<uint8_t>(~bit);
+                pending_votes_.remove(sources_.slot(*source), msg.checkpoint_id, bit);
             }
+            tally_votes(*source, *config_.read());
+        }
+        config_.quiescent_state();
+    }
+
+    /// Withdraw dead verdicts of other voters that did not reach the quorum within two leases
+    /**
+     * Every voter detects an expiry within a lease of the others, so a verdict left alone for
+     * longer is one the rest of the ensemble disagrees with.
+     */
+    void expire_votes()
+    {
+        const int64_t timeout_ns = 2 * std::chrono::duration_cast<std::chrono::nanoseconds>(
+            config_.read()->lease).count();
+        config_.quiescent_state();
+        pending_votes_.expire(this->get_clock()->now().nanoseconds(), timeout_ns,
+                              [this](const PendingVotes::Vote & vote) {
+                                  SourceState * source = sources_.find(vote.checkpoint_id);
+                                  if(source && !source->quorum_reached)
+                                      source->votes &= static_cast<uint8_t>(~vote.bit);
+                              });
+    }
+
+    /// Decay the flap scores of damped sources and report those that stay dead after release
+    void review_damped_sources()
+    {
+        const WatchdogConfig * config = config_.read();
+        if(config->flap.enabled()) {
+            const int64_t now_ns = this->get_clock()->now().nanoseconds();
+            sources_.for_each([&](SourceState & source) {
+                if(source.flap.damped && flap_decay(source.flap, config->flap, now_ns) &&
+                   source.expired && !source.departed)
+                    declare_dead(source, *config);
+            });
         }
-        *lost_message = node_id_list.at(result.first).back();
-        return false;
+        config_.quiescent_state();
     }
 
-    /// Publish lease expiry of the watched entity
-    void publish_failure(sw_watchdog_msgs::msg::Heartbeat lost_message)
+    /// Free the slots of departed sources and of sources silent for longer than the retention
+    /**
+     * Sources are otherwise only evicted to make room for a new one, so a table that never fills
+     * up would keep reporting long gone sources in the health ranking. A retention of 0 leaves
+     * eviction to the insertion of new sources.
+     */
+    void evict_stale_sources()
     {
+        const int64_t retention_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            config_.read()->retention).count();
+        config_.quiescent_state();
+        if(retention_ns <= 0)
+            return;
+        const std::size_t evicted =
+            sources_.evict_stale(this->get_clock()->now().nanoseconds(), retention_ns);
+        if(evicted && !realtime_)
+            RCLCPP_INFO(get_logger(), "Evicted %zu departed or silent source(s), %lu in total",
+                        evicted, static_cast<unsigned long>(sources_.evictions()));
+    }
+
+    /// Publish lease expiry or flooding of a watched entity
+    /**
+     * If host is given, the expiry is attributed to that host, affecting the given number of
+     * sources.
+     */
+    void publish_failure(const SourceState & source, const std::string * host = nullptr,
+                         uint16_t affected_sources = 0)
+    {
+        if(realtime_) {
+            // Reuse the preallocated message and skip console output
+            status_msg_.header.stamp = this->get_clock()->now();
+            fill_status(status_msg_, source);
+            // The host name fits into the capacity reserved on configure
+            if(host)
+                status_msg_.host.assign(*host);
+            else
+                status_msg_.host.clear();
+            status_msg_.affected_sources = affected_sources;
+            failure_pub_->publish(status_msg_);
+            return;
+        }
         auto msg = std::make_unique<sw_watchdog_msgs::msg::Status>();
         rclcpp::Time now = this->get_clock()->now();
         msg->header.stamp = now;
-        msg->missed_number = lost_message.checkpoint_id;
-        RCLCPP_INFO(get_logger(),
-                        "Publishing failure message. Faulty node was with ID %u at [%f] seconds",
-                        msg->missed_number, now.seconds());
+        fill_status(*msg, source);
+        if(host) {
+            msg->host = *host;
+            msg->affected_sources = affected_sources;
+            RCLCPP_INFO(get_logger(),
+                        "Publishing failure message. Host %s with %u sources unreachable at [%f] "
+                        "seconds",
+                        host->c_str(), affected_sources, now.seconds());
+        } else {
+            RCLCPP_INFO(get_logger(),
+                        "Publishing failure message. Faulty node was with ID %u at [%f] "
+                        "seconds%s%s%s%s",
+                        msg->missed_number, now.seconds(), msg->flooding ? " (flooding)" : "",
+                        msg->unstable ? " (unstable)" : "", msg->stuck ? " (stuck)" : "",
+                        msg->stale ? " (stale)" : "");
+        }
+        if(msg->metrics.valid)
+            RCLCPP_INFO(get_logger(),
+                        "Last load of ID %u: loop time %u us, CPU %.1f %%, queue depth %u",
+                        msg->checkpoint_id, msg->metrics.loop_time_us,
+                        msg->metrics.cpu_permille / 10.0, msg->metrics.queue_depth);
         // Print the current state for demo purposes 
         /*
         if (!failure_pub_->is_activated()) {
@@ -180,33 +1234,137 @@ public:
         failure_pub_->publish(std::move(msg));
     }
 
+    /// Publish that a member of a sync set arrived too late in a cycle or missed it
+    void publish_sync_violation(const SyncSets::Set & set, uint16_t position, int64_t skew_ns)
+    {
+        const uint16_t checkpoint_id = set.ids[position];
+        SourceState untracked;
+        untracked.checkpoint_id = checkpoint_id;
+        const SourceState * source = sources_.find(checkpoint_id);
+        if(!source)
+            source = &untracked;
+        if(realtime_) {
+            // The set name fits into the capacity reserved on configure
+            status_msg_.header.stamp = this->get_clock()->now();
+            fill_status(status_msg_, *source);
+            status_msg_.host.clear();
+            status_msg_.affected_sources = 0;
+            status_msg_.sync_set.assign(set.name);
+            status_msg_.skew_ns = skew_ns;
+            failure_pub_->publish(status_msg_);
+            return;
+        }
+        auto msg = std::make_unique<sw_watchdog_msgs::msg::Status>();
+        rclcpp::Time now = this->get_clock()->now();
+        msg->header.stamp = now;
+        fill_status(*msg, *source);
+        msg->sync_set = set.name;
+        msg->skew_ns = skew_ns;
+        if(skew_ns == SYNC_MISSED)
+            RCLCPP_INFO(get_logger(),
+                        "Publishing failure message. ID %u missed a cycle of sync set %s at [%f] "
+                        "seconds", checkpoint_id, set.name.c_str(), now.seconds());
+        else
+            RCLCPP_INFO(get_logger(),
+                        "Publishing failure message. ID %u lagged %.1f ms behind in sync set %s at "
+                        "[%f] seconds", checkpoint_id, skew_ns / 1e6, set.name.c_str(),
+                        now.seconds());
+        failure_pub_->publish(std::move(msg));
+    }
+
     /// Transition callback for state configuring
     rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn on_configure(
         const rclcpp_lifecycle::State &)
     {
         // Initialize and configure node
+        if(realtime_) {
+            // mlockall() applies to the process, not to this node: in a shared component
+            // container, every other component ends up locked into RAM as well
+            std::string error;
+            if(!lock_memory(&error)) {
+                RCLCPP_ERROR(get_logger(), "Cannot enter real-time mode: %s", error.c_str());
+                return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+            }
+        }
         qos_profile_
             .liveliness(RMW_QOS_POLICY_LIVELINESS_MANUAL_BY_TOPIC)
-            .liveliness_lease_duration(lease_duration_);
+            .liveliness_lease_duration(config_.read()->lease);
+        // The expected sources are known up front and get a perfect hash lookup
+        sources_.reset(config_.read()->max_sources, config_.read()->expected_sources);
+        hosts_.assign(config_.read()->host_names.size(), HostState());
+        if(hosts_.size() > 1)
+            warn_unplaced_sources(*config_.read());
+        std::size_t longest_host = 0;
+        for(const std::string & host : config_.read()->host_names)
+            longest_host = std::max(longest_host, host.size());
+        status_msg_.host.reserve(longest_host);
+        dependencies_ = config_.read()->dependencies;
+        if(dependencies_)
+            dependency_state_.reset(*dependencies_);
+        groups_ = config_.read()->groups;
+        if(groups_) {
+            group_state_.reset(*groups_);
+            std::size_t longest_name = 0;
+            for(uint32_t group = 0; group < groups_->size(); ++group)
+                longest_name = std::max(longest_name, groups_->group(group).name.size());
+            group_status_msg_.group.reserve(longest_name);
+            group_status_pub_ = create_publisher<sw_watchdog_msgs::msg::GroupStatus>(
+                GROUP_STATUS_TOPIC_NAME, rclcpp::QoS(groups_->size()).reliable());
+        }
+        sync_sets_ = config_.read()->sync_sets;
+        if(sync_sets_) {
+            sync_state_.reset(*sync_sets_);
+            std::size_t longest_name = 0;
+            for(uint32_t set = 0; set < sync_sets_->size(); ++set)
+                longest_name = std::max(longest_name, sync_sets_->set(set).name.size());
+            status_msg_.sync_set.reserve(longest_name);
+        }
+        pending_expiries_.clear();
+        pending_expiries_.reserve(config_.read()->max_sources);
+        config_.quiescent_state();
 
         heartbeat_sub_options_.event_callbacks.liveliness_callback =
             [this](rclcpp::QOSLivelinessChangedInfo &event) -> void {
-                printf("Reader Liveliness changed event: \n");
-                printf("  alive_count: %d\n", event.alive_count);
-                printf("  not_alive_count: %d\n", event.not_alive_count);
-                printf("  alive_count_change: %d\n", event.alive_count_change);
-                printf("  not_alive_count_change: %d\n", event.not_alive_count_change);
-                if(event.alive_count_change <= 0) {
-                    sw_watchdog_msgs::msg::Heartbeat lost_message;
-                    // Check which message got lost in the cache
-                    if(!check_messages_in_cache(&lost_message)){
-                        publish_failure(lost_message);
-                    }
+                if(!realtime_) {
+                    printf("Reader Liveliness changed event: \n");
+                    printf("  alive_count: %d\n", event.alive_count);
+                    printf("  not_alive_count: %d\n", event.not_alive_count);
+                    printf("  alive_count_change: %d\n", event.alive_count_change);
+                    printf("  not_alive_count_change: %d\n", event.not_alive_count_change);
                 }
+                // Writers that were never alive or are removed while not alive change the not alive
+                // count only; they are not a liveliness loss.
+                // Sources are only tracked, and their leases armed, from their first heartbeat.
+                for(int32_t lost = event.alive_count_change; lost < 0; ++lost)
+                    on_liveliness_lost();
+                config_.quiescent_state();
             };
 
         if(enable_pub_)
             failure_pub_ = create_publisher<sw_watchdog_msgs::msg::Status>("failure", 1); /* QoS history_depth */
+        if(registrar_ && !registration_srv_)
+            registration_srv_ = create_service<sw_watchdog_msgs::srv::RegisterSource>(
+                REGISTRATION_SERVICE_NAME,
+                std::bind(&SimpleWatchdog::on_register_source, this, std::placeholders::_1,
+                          std::placeholders::_2));
+        if(!ranking_srv_)
+            ranking_srv_ = create_service<sw_watchdog_msgs::srv::GetHealthRanking>(
+                HEALTH_RANKING_NAME,
+                std::bind(&SimpleWatchdog::on_get_health_ranking, this, std::placeholders::_1,
+                          std::placeholders::_2));
+        ranking_pub_ =
+            create_publisher<sw_watchdog_msgs::msg::HealthRanking>(HEALTH_RANKING_NAME, 1);
+        ranking_msg_.sources.clear();
+        ranking_msg_.sources.reserve(config_.read()->ranking_size);
+        if(config_.read()->voting()) {
+            // A mass expiry makes every voter publish a verdict per source at once
+            verdict_depth_ = config_.read()->max_sources * MAX_VOTERS;
+            verdict_pub_ = create_publisher<sw_watchdog_msgs::msg::Verdict>(
+                VERDICT_TOPIC_NAME, rclcpp::QoS(verdict_depth_).reliable());
+            verdict_msg_.voter = voters_.self();
+            pending_votes_.reset(config_.read()->max_sources);
+        }
+        config_.quiescent_state();
 
         RCUTILS_LOG_INFO_NAMED(get_name(), "on_configure() is called.");
         return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
@@ -217,21 +1375,64 @@ public:
         const rclcpp_lifecycle::State &)
     {
         if(!heartbeat_sub_) {
-            heartbeat_sub_ = create_subscription<sw_watchdog_msgs::msg::Heartbeat>(
-                topic_name_,
-                qos_profile_,
-                [this](const typename sw_watchdog_msgs::msg::Heartbeat::SharedPtr msg) -> void {
-                    RCLCPP_INFO(get_logger(), "Watchdog raised, heartbeat sent at %d seconds", msg->header.stamp.sec);
-                },
-                heartbeat_sub_options_);
+            create_heartbeat_subscription();
+            config_.quiescent_state();
         }
-
-        heartbeat_cache.registerCallback(&SimpleWatchdog::cache_callback, this); // Uncertain if even required
-        //heartbeat_cache.registerCallback(std::bind(&SimpleWatchdog::cache_callback, this, sw_watchdog_msgs::msg::Heartbeat));
+        registration_open_ns_ = this->get_clock()->now().nanoseconds() +
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config_.read()->lease).count();
+        config_.quiescent_state();
+        if(verdict_pub_ && !verdict_sub_)
+            verdict_sub_ = create_subscription<sw_watchdog_msgs::msg::Verdict>(
+                VERDICT_TOPIC_NAME, rclcpp::QoS(verdict_depth_).reliable(),
+                std::bind(&SimpleWatchdog::on_verdict, this, std::placeholders::_1));
+        // Correlating expiries delays their reports by up to a lease; voters report individually
+        if(!correlation_timer_ && hosts_.size() > 1 && !voting()) {
+            correlation_timer_ = create_wall_timer(
+                std::max<std::chrono::milliseconds>(config_.read()->lease / 8, 1ms),
+                [this]() -> void { correlate_expiries(this->get_clock()->now().nanoseconds()); });
+            config_.quiescent_state();
+        }
+        if(!startup_timer_ && config_.read()->startup_deadline.count() > 0)
+            startup_timer_ = create_wall_timer(config_.read()->startup_deadline,
+                                               std::bind(&SimpleWatchdog::check_startup, this));
+        config_.quiescent_state();
+        if(!ranking_timer_ && config_.read()->ranking_period.count() > 0)
+            ranking_timer_ = create_wall_timer(config_.read()->ranking_period,
+                                               std::bind(&SimpleWatchdog::publish_ranking, this));
+        config_.quiescent_state();
+        if(!probe_timer_ && config_.read()->probe_period.count() > 0) {
+            probe_pub_ = create_publisher<sw_watchdog_msgs::msg::Probe>(PROBE_TOPIC_NAME, 1);
+            probe_pub_->on_activate();
+            probe_timer_ = create_wall_timer(config_.read()->probe_period,
+                                             std::bind(&SimpleWatchdog::send_probe, this));
+        }
+        config_.quiescent_state();
+        if(!attribution_timer_) {
+            // Checks for overdue sources only while liveliness losses are held back
+            attribution_timer_ = create_wall_timer(
+                std::max<std::chrono::milliseconds>(config_.read()->lease / 8, 1ms),
+                std::bind(&SimpleWatchdog::attribute_losses, this));
+            attribution_timer_->cancel();
+            unattributed_losses_ = 0;
+            departures_ = 0;
+        }
+        config_.quiescent_state();
+        if(!review_timer_)
+            review_timer_ = create_wall_timer(1s, [this]() -> void {
+                review_damped_sources();
+                evict_stale_sources();
+                if(voting())
+                    expire_votes();
+            });
 
         // Starting from this point, all messages are sent to the network.
         if (enable_pub_)
             failure_pub_->on_activate();
+        if(verdict_pub_)
+            verdict_pub_->on_activate();
+        if(group_status_pub_)
+            group_status_pub_->on_activate();
+        ranking_pub_->on_activate();
 
         // Starting from this point, all messages are sent to the network.
         RCUTILS_LOG_INFO_NAMED(get_name(), "on_activate() is called.");
@@ -244,10 +1445,36 @@ public:
     {
         heartbeat_sub_.reset(); // XXX there does not seem to be a 'deactivate' for subscribers.
         heartbeat_sub_ = nullptr;
+        review_timer_.reset();
+        attribution_timer_.reset();
+        startup_timer_.reset();
+        ranking_timer_.reset();
+        probe_timer_.reset();
+        probe_pub_.reset();
+        verdict_sub_.reset();
+        if(correlation_timer_) {
+            // Close all windows, held back expiries are not to be lost
+            correlate_expiries(INT64_MAX);
+            correlation_timer_.reset();
+        }
 
         // Starting from this point, all messages are no longer sent to the network.
         if(enable_pub_)
             failure_pub_->on_deactivate();
+        if(verdict_pub_)
+            verdict_pub_->on_deactivate();
+        if(group_status_pub_)
+            group_status_pub_->on_deactivate();
+        ranking_pub_->on_deactivate();
+
+        for(std::size_t level = 0; level < CRITICALITY_LEVELS; ++level) {
+            const ClassLatency & latency = latencies_[level];
+            if(latency.count)
+                RCLCPP_INFO(get_logger(),
+                            "Criticality %zu: %lu heartbeats, latency mean %.1f us, max %.1f us",
+                            level, static_cast<unsigned long>(latency.count),
+                            latency.mean_ns() / 1e3, latency.max_ns / 1e3);
+        }
 
         RCUTILS_LOG_INFO_NAMED(get_name(), "on_deactivate() is called.");
 
@@ -259,6 +1486,11 @@ public:
         const rclcpp_lifecycle::State &)
     {
         failure_pub_.reset();
+        verdict_pub_.reset();
+        group_status_pub_.reset();
+        registration_srv_.reset();
+        ranking_pub_.reset();
+        ranking_srv_.reset();
         RCUTILS_LOG_INFO_NAMED(get_name(), "on cleanup is called.");
 
         return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
@@ -270,7 +1502,13 @@ public:
     {
         heartbeat_sub_.reset();
         heartbeat_sub_ = nullptr;
+        verdict_sub_.reset();
         failure_pub_.reset();
+        verdict_pub_.reset();
+        group_status_pub_.reset();
+        registration_srv_.reset();
+        ranking_pub_.reset();
+        ranking_srv_.reset();
 
         RCUTILS_LOG_INFO_NAMED(get_name(), "on shutdown is called from state %s.", state.label().c_str());
 
@@ -278,23 +1516,98 @@ public:
     }
 
 private:
-    /// The lease duration granted to the remote (heartbeat) publisher
-    std::chrono::milliseconds lease_duration_;
+    /// Runtime configuration, swapped as a whole when parameters change
+    RcuCell<WatchdogConfig> config_;
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_cb_handle_;
     rclcpp::Subscription<sw_watchdog_msgs::msg::Heartbeat>::SharedPtr heartbeat_sub_ = nullptr;
-    // A seperate Message Filters Subscription is requiered for the Cache
-    message_filters::Subscriber<sw_watchdog_msgs::msg::Heartbeat> heartbeat_cache_sub;
-    message_filters::Cache<sw_watchdog_msgs::msg::Heartbeat> heartbeat_cache; 
+    /// Periodic review of damped and stale sources while active
+    rclcpp::TimerBase::SharedPtr review_timer_;
+    /// Liveliness losses no source was overdue for yet, when the last one occurred, and the
+    /// timer looking for their sources
+    uint32_t unattributed_losses_ = 0;
+    int64_t last_loss_ns_ = 0;
+    rclcpp::TimerBase::SharedPtr attribution_timer_;
+    /// Departures whose liveliness loss is still expected, and when the last one was announced
+    uint32_t departures_ = 0;
+    int64_t last_departure_ns_ = 0;
+    /// One-shot check of the expected sources at the startup deadline
+    rclcpp::TimerBase::SharedPtr startup_timer_;
+    /// Dependencies between the sources as of the last configure, and which of them are down
+    std::shared_ptr<const DependencyGraph> dependencies_;
+    DependencyState dependency_state_;
+    /// Groups of redundant sources as of the last configure, their health and its publication
+    std::shared_ptr<const SourceGroups> groups_;
+    SourceGroupState group_state_;
+    std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sw_watchdog_msgs::msg::GroupStatus>>
+        group_status_pub_;
+    sw_watchdog_msgs::msg::GroupStatus group_status_msg_;
+    /// Sets of sources that have to beat in sync as of the last configure, and their arrivals
+    std::shared_ptr<const SyncSets> sync_sets_;
+    SyncState sync_state_;
+    /// Correlation of expiries per host, indexed like WatchdogConfig::host_names
+    std::vector<HostState> hosts_;
+    /// Checkpoint ids of the expiries held back in the current window, reserved to max_sources
+    std::vector<uint16_t> pending_expiries_;
+    rclcpp::TimerBase::SharedPtr correlation_timer_;
+    /// Monitoring state of the heartbeat sources, bounded by the max_sources parameter
+    SourceTable sources_;
     /// Publish lease expiry for the watched entity
     // By default, a lifecycle publisher is inactive by creation and has to be activated to publish.
     std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sw_watchdog_msgs::msg::Status>> failure_pub_ = nullptr;
+    /// Least healthy sources, published periodically and on request
+    std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sw_watchdog_msgs::msg::HealthRanking>> ranking_pub_;
+    rclcpp::Service<sw_watchdog_msgs::srv::GetHealthRanking>::SharedPtr ranking_srv_;
+    rclcpp::TimerBase::SharedPtr ranking_timer_;
+    /// Preallocated ranking message, its sources reserved to ranking_size
+    sw_watchdog_msgs::msg::HealthRanking ranking_msg_;
+    /// Liveness probes while active and probing, and the send times of the outstanding ones
+    std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sw_watchdog_msgs::msg::Probe>> probe_pub_;
+    rclcpp::TimerBase::SharedPtr probe_timer_;
+    ProbeWindow probes_;
+    sw_watchdog_msgs::msg::Probe probe_msg_;
+    /// Registration of sources, handing out checkpoint ids that index the source table directly
+    bool registrar_ = false;
+    CheckpointRegistry registry_;
+    /// Node clock time from which on registrations are served, a lease after activation
+    int64_t registration_open_ns_ = INT64_MAX;
+    rclcpp::Service<sw_watchdog_msgs::srv::RegisterSource>::SharedPtr registration_srv_;
+    /// Voting ensemble this instance is part of, and the verdicts exchanged with it
+    VoterRegistry voters_;
+    std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sw_watchdog_msgs::msg::Verdict>> verdict_pub_;
+    rclcpp::Subscription<sw_watchdog_msgs::msg::Verdict>::SharedPtr verdict_sub_;
+    sw_watchdog_msgs::msg::Verdict verdict_msg_;
+    std::size_t verdict_depth_ = MAX_VOTERS;
+    PendingVotes pending_votes_;
     /// Whether to enable the watchdog on startup. Otherwise, lifecycle transitions have to be raised.
     bool autostart_;
     /// Whether a lease expiry should be published
     bool enable_pub_;
+    /// Whether the active state has to stay free of allocations and blocking I/O
+    bool realtime_ = false;
+    /// Preallocated status message, reused for every publication
+    sw_watchdog_msgs::msg::Status status_msg_;
     /// Topic name for heartbeat signal by the watched entity
     const std::string topic_name_;
     rclcpp::QoS qos_profile_;
     rclcpp::SubscriptionOptions heartbeat_sub_options_;
+    /// Whether the rmw evaluates content filters; assumed until proven otherwise
+#ifdef SW_WATCHDOG_HAS_CONTENT_FILTER
+    bool content_filter_supported_ = true;
+#else
+    bool content_filter_supported_ = false;
+#endif
+    /// Deserialization of heartbeats that passed the local shard filter
+    rclcpp::Serialization<sw_watchdog_msgs::msg::Heartbeat> heartbeat_serialization_;
+    /// Reused storage for serialized heartbeats taken directly from the reader
+    rclcpp::SerializedMessage serialized_msg_;
+    /// Heartbeats taken in the current wakeup, and their order of processing per criticality class
+    std::vector<sw_watchdog_msgs::msg::Heartbeat> batch_ =
+        std::vector<sw_watchdog_msgs::msg::Heartbeat>(MAX_HEARTBEAT_BATCH);
+    std::size_t batch_size_ = 0;
+    std::array<std::array<uint16_t, MAX_HEARTBEAT_BATCH>, CRITICALITY_LEVELS> class_order_;
+    std::array<std::size_t, CRITICALITY_LEVELS> class_size_ = {};
+    /// Heartbeat processing latency per criticality class
+    CriticalityLatencies latencies_;
 };
 
 } // namespace sw_watchdog
@@ -12,8 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <chrono>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 
 #include "rclcpp/rclcpp.hpp"
@@ -26,20 +28,28 @@
 
 #include "sw_watchdog_msgs/msg/heartbeat.hpp"
 #include "sw_watchdog_msgs/msg/status.hpp"
+#include "sw_watchdog/flap_damping.hpp"
+#include "sw_watchdog/rcu.hpp"
+#include "sw_watchdog/realtime.hpp"
 #include "sw_watchdog/visibility_control.h"
+#include "sw_watchdog/watchdog_config.hpp"
 
 using namespace std::chrono_literals;
 
 constexpr char OPTION_AUTO_START[] = "--activate";
 constexpr char OPTION_PUB_STATUS[] = "--publish";
+constexpr char OPTION_REALTIME[] = "--realtime";
 constexpr char DEFAULT_TOPIC_NAME[] = "heartbeat";
+/// Upper bound of heartbeats handled per executor wakeup, so other callbacks are not starved
+constexpr std::size_t MAX_HEARTBEAT_BATCH = 256;
 
 namespace {
 
 void print_usage()
 {
     std::cout <<
-        "Usage: windowed_watchdog lease max-misses [" << OPTION_AUTO_START << "] [-h]\n\n"
+        "Usage: windowed_watchdog lease max-misses [" << OPTION_AUTO_START << "] [" <<
+        OPTION_PUB_STATUS << "] [" << OPTION_REALTIME << "] [-h]\n\n"
         "required arguments:\n"
         "\tlease: Lease in positive integer milliseconds granted to the watched entity.\n"
         "\tmax-misses: The maximum number of lease violations granted to the watched entity.\n"
@@ -47,6 +57,10 @@ void print_usage()
         "\t" << OPTION_AUTO_START << ": Start the watchdog on creation.  Defaults to false.\n"
         "\t" << OPTION_PUB_STATUS << ": Publish lease expiration of the watched entity.  "
         "Defaults to false.\n"
+        "\t" << OPTION_REALTIME << ": Lock memory on configure and keep the active state free of "
+        "allocations and console I/O.  Defaults to false.\n"
+        "\t\tThe whole process is locked, in a component container with all other components\n"
+        "\t\tloaded into it; use a dedicated container or the standalone executable.\n"
         "\t-h : Print this help message." <<
         std::endl;
 }
@@ -68,8 +82,9 @@ public:
     SW_WATCHDOG_PUBLIC
     explicit WindowedWatchdog(const rclcpp::NodeOptions& options)
         : rclcpp_lifecycle::LifecycleNode("windowed_watchdog", options),
+          config_(std::make_unique<const WatchdogConfig>()),
           autostart_(false), enable_pub_(false), topic_name_(DEFAULT_TOPIC_NAME),
-          lease_misses_(0), qos_profile_(10)
+          qos_profile_(10)
     {
         // Parse node arguments
         const std::vector<std::string>& args = this->get_node_options().arguments();
@@ -86,13 +101,51 @@ public:
         }
 
         // Lease duration must be >= heartbeat's lease duration
-        lease_duration_ = std::chrono::milliseconds(std::stoul(args[1]));
-        max_misses_ = std::stoul(args[2]);
+        auto config = std::make_unique<WatchdogConfig>();
+        config->lease = std::chrono::milliseconds(std::stoul(args[1]));
+        config->max_misses = std::stoul(args[2]);
+        config->lease = std::chrono::milliseconds(
+            declare_parameter("lease", static_cast<int64_t>(config->lease.count())));
+        const int64_t max_misses =
+            declare_parameter("max_misses", static_cast<int64_t>(config->max_misses));
+        if(config->lease.count() <= 0 || max_misses <= 0 || max_misses > UINT16_MAX) {
+            RCLCPP_ERROR(get_logger(), "lease has to be positive, max_misses in [1, 65535]");
+            print_usage();
+            std::exit(-1);
+        }
+        config->max_misses = static_cast<uint16_t>(max_misses);
+        config->flap.half_life_s = static_cast<float>(
+            declare_parameter("flap_half_life", static_cast<int64_t>(0))) / 1000.0f;
+        config->flap.suppress = static_cast<float>(
+            declare_parameter("flap_suppress", static_cast<double>(config->flap.suppress)));
+        config->flap.reuse = static_cast<float>(
+            declare_parameter("flap_reuse", static_cast<double>(config->flap.reuse)));
+        if(config->flap.reuse >= config->flap.suppress ||
+           config->flap.suppress >= config->flap.ceiling) {
+            // A suppress threshold at the ceiling would never be reached
+            RCLCPP_ERROR(get_logger(), "flap_reuse has to be below flap_suppress, "
+                         "flap_suppress below the flap score ceiling of %.0f",
+                         static_cast<double>(config->flap.ceiling));
+            print_usage();
+            std::exit(-1);
+        }
+        config->startup_deadline = std::chrono::milliseconds(declare_parameter(
+            "startup_deadline", static_cast<int64_t>(config->startup_deadline.count())));
+        config->progress_timeout = std::chrono::milliseconds(declare_parameter(
+            "progress_timeout", static_cast<int64_t>(config->progress_timeout.count())));
+        config->max_input_age.default_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::milliseconds(declare_parameter("max_input_age", static_cast<int64_t>(0))))
+            .count();
+        config_.update(std::move(config));
+        param_cb_handle_ = add_on_set_parameters_callback(
+            std::bind(&WindowedWatchdog::on_set_parameters, this, std::placeholders::_1));
 
         if(rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), OPTION_AUTO_START))
             autostart_ = true;
         if(rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), OPTION_PUB_STATUS))
             enable_pub_ = true;
+        if(rcutils_cli_option_exist(&cargs[0], &cargs[0] + cargs.size(), OPTION_REALTIME))
+            realtime_ = true;
 
         if(autostart_) {
             configure();
@@ -100,13 +153,133 @@ public:
         }
     }
 
+    /// Validate parameter updates and publish them as a new configuration snapshot
+    rcl_interfaces::msg::SetParametersResult on_set_parameters(
+        const std::vector<rclcpp::Parameter> & parameters)
+    {
+        rcl_interfaces::msg::SetParametersResult result;
+        result.successful = true;
+        auto config = std::make_unique<WatchdogConfig>(*config_.read());
+        for(const rclcpp::Parameter & parameter : parameters) {
+            if(parameter.get_name() == "lease") {
+                if(parameter.as_int() <= 0) {
+                    result.successful = false;
+                    result.reason = "lease has to be a positive number of milliseconds";
+                    return result;
+                }
+                config->lease = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "max_misses") {
+                if(parameter.as_int() <= 0 || parameter.as_int() > UINT16_MAX) {
+                    result.successful = false;
+                    result.reason = "max_misses has to be in [1, 65535]";
+                    return result;
+                }
+                config->max_misses = static_cast<uint16_t>(parameter.as_int());
+            } else if(parameter.get_name() == "progress_timeout") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "progress_timeout must not be negative";
+                    return result;
+                }
+                config->progress_timeout = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "max_input_age") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "max_input_age must not be negative";
+                    return result;
+                }
+                config->max_input_age.default_ns =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::milliseconds(parameter.as_int())).count();
+            } else if(parameter.get_name() == "startup_deadline") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "startup_deadline must not be negative";
+                    return result;
+                }
+                config->startup_deadline = std::chrono::milliseconds(parameter.as_int());
+            } else if(parameter.get_name() == "flap_half_life") {
+                if(parameter.as_int() < 0) {
+                    result.successful = false;
+                    result.reason = "flap_half_life must not be negative";
+                    return result;
+                }
+                config->flap.half_life_s = static_cast<float>(parameter.as_int()) / 1000.0f;
+            } else if(parameter.get_name() == "flap_suppress") {
+                config->flap.suppress = static_cast<float>(parameter.as_double());
+            } else if(parameter.get_name() == "flap_reuse") {
+                config->flap.reuse = static_cast<float>(parameter.as_double());
+            }
+        }
+        if(config->flap.reuse >= config->flap.suppress) {
+            result.successful = false;
+            result.reason = "flap_reuse has to be below flap_suppress";
+            return result;
+        }
+        if(config->flap.suppress >= config->flap.ceiling) {
+            result.successful = false;
+            result.reason = "flap_suppress has to be below the flap score ceiling of " +
+                            std::to_string(static_cast<int>(config->flap.ceiling));
+            return result;
+        }
+        // Lease changes reach the QoS deadline on the next configure, the startup deadline the next
+        // activate, max_misses applies to the very next deadline event.
+        config_.update(std::move(config));
+        return result;
+    }
+
+    /// Report the watched entity once if its heartbeats arrive while its progress stands still
+    void check_progress(uint64_t progress)
+    {
+        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+        const int64_t timeout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            config_.read()->progress_timeout).count();
+        if(progress != progress_ || !progress_ns_) {
+            progress_ = progress;
+            progress_ns_ = now_ns;
+            stuck_ = false;
+        } else if(timeout_ns > 0 && !stuck_ && now_ns - progress_ns_ >= timeout_ns) {
+            stuck_ = true;
+            if(enable_pub_)
+                publish_status(0);
+        }
+    }
+
+    /// Report the watched entity once when it starts acting on inputs older than the maximum age
+    void check_input_age(int64_t input_age_ns)
+    {
+        const int64_t limit_ns = config_.read()->max_input_age.default_ns;
+        const bool stale = limit_ns > 0 && input_age_ns > limit_ns;
+        const bool report = stale && !stale_;
+        stale_ = stale;
+        if(report && enable_pub_)
+            publish_status(0);
+    }
+
     /// Publish lease expiry of the watched entity
-    void publish_status(uint16_t misses)
+    void publish_status(uint16_t misses, bool absent = false)
     {
+        if(realtime_) {
+            // Reuse the preallocated message and skip console output
+            status_msg_.stamp = this->get_clock()->now();
+            status_msg_.missed_number = misses;
+            status_msg_.unstable = flap_.damped;
+            status_msg_.absent = absent;
+            status_msg_.stuck = stuck_;
+            status_msg_.stale = stale_;
+            status_msg_.metrics = metrics_;
+            status_pub_->publish(status_msg_);
+            return;
+        }
         auto msg = std::make_unique<sw_watchdog_msgs::msg::Status>();
         rclcpp::Time now = this->get_clock()->now();
         msg->stamp = now;
         msg->missed_number = misses;
+        msg->unstable = flap_.damped;
+        msg->absent = absent;
+        msg->stuck = stuck_;
+        msg->stale = stale_;
+        msg->metrics = metrics_;
 
         // Print the current state for demo purposes
         if (!status_pub_->is_activated()) {
@@ -128,21 +301,60 @@ public:
         const rclcpp_lifecycle::State &)
     {
         // Initialize and configure node
+        if(realtime_) {
+            // mlockall() applies to the process, not to this node: in a shared component
+            // container, every other component ends up locked into RAM as well
+            std::string error;
+            if(!lock_memory(&error)) {
+                RCLCPP_ERROR(get_logger(), "Cannot enter real-time mode: %s", error.c_str());
+                return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+            }
+        }
+        const WatchdogConfig * config = config_.read();
         qos_profile_
             .liveliness(RMW_QOS_POLICY_LIVELINESS_MANUAL_BY_TOPIC)
-            .liveliness_lease_duration(lease_duration_ * (uint16_t) lease_misses_)
-            .deadline(lease_duration_);
+            .liveliness_lease_duration(config->lease * config->max_misses)
+            .deadline(config->lease);
+        config_.quiescent_state();
 
         heartbeat_sub_options_.event_callbacks.deadline_callback =
             [this](rclcpp::QOSDeadlineRequestedInfo& event) -> void {
-                printf("Requested deadline missed - total %d delta %d\n",
-                   event.total_count, event.total_count_change);
-                lease_misses_.fetch_add(static_cast<uint16_t>(event.total_count_change),
-                                        std::memory_order_relaxed);
-
-                publish_status(lease_misses_);
+                if(!realtime_)
+                    printf("Requested deadline missed - total %d delta %d\n",
+                       event.total_count, event.total_count_change);
+                // The lease is armed by the first heartbeat; a departed entity is expected to be
+                // silent
+                if(!armed_.load(std::memory_order_acquire) ||
+                   departed_.load(std::memory_order_acquire))
+                    return;
+                const uint64_t misses = lease_misses_.fetch_add(
+                    static_cast<uint64_t>(event.total_count_change),
+                    std::memory_order_relaxed) +
+                    static_cast<uint64_t>(event.total_count_change);
+                const WatchdogConfig * config = config_.read();
+                const uint16_t max_misses = config->max_misses;
+                if(config->flap.enabled()) {
+                    const int64_t now_ns = this->get_clock()->now().nanoseconds();
+                    bool became_damped = false;
+                    if(!missing_)
+                        became_damped = flap_transition(flap_, config->flap, now_ns);
+                    else
+                        flap_decay(flap_, config->flap, now_ns);
+                    missing_ = true;
+                    // While damped, report the instability once and neither publish every miss
+                    // nor deactivate; a lasting outage lets the score decay and is handled below.
+                    if(flap_.damped) {
+                        config_.quiescent_state();
+                        if(became_damped && enable_pub_)
+                            publish_status(static_cast<uint16_t>(std::min<uint64_t>(misses, UINT16_MAX)));
+                        return;
+                    }
+                }
+                missing_ = true;
+                config_.quiescent_state();
+                publish_status(static_cast<uint16_t>(std::min<uint64_t>(misses, UINT16_MAX)));
                 // Transition lifecycle to deactivated state
-                if(lease_misses_ >= max_misses_)
+                if(misses >= max_misses)
                     deactivate();
         };
 
@@ -150,13 +362,22 @@ public:
         // does not account for that)
         heartbeat_sub_options_.event_callbacks.liveliness_callback =
             [this](rclcpp::QOSLivelinessChangedInfo &event) -> void {
-                printf("Reader Liveliness changed event: \n");
-                printf("  alive_count: %d\n", event.alive_count);
-                printf("  not_alive_count: %d\n", event.not_alive_count);
-                printf("  alive_count_change: %d\n", event.alive_count_change);
-                printf("  not_alive_count_change: %d\n", event.not_alive_count_change);
-                if(event.alive_count == 0) {
-                    publish_status(max_misses_);
+                if(!realtime_) {
+                    printf("Reader Liveliness changed event: \n");
+                    printf("  alive_count: %d\n", event.alive_count);
+                    printf("  not_alive_count: %d\n", event.not_alive_count);
+                    printf("  alive_count_change: %d\n", event.alive_count_change);
+                    printf("  not_alive_count_change: %d\n", event.not_alive_count_change);
+                }
+                if(!armed_.load(std::memory_order_acquire)) {
+                    // Discovery still in progress, nothing to enforce yet
+                } else if(event.alive_count == 0 && departed_.load(std::memory_order_acquire)) {
+                    if(!realtime_)
+                        RCLCPP_INFO(get_logger(), "Watched entity departed, no lease violation");
+                } else if(event.alive_count == 0) {
+                    const uint16_t max_misses = config_.read()->max_misses;
+                    config_.quiescent_state();
+                    publish_status(max_misses);
                     // Transition lifecycle to deactivated state
                     deactivate();
                 }
@@ -178,12 +399,61 @@ public:
                 topic_name_,
                 qos_profile_,
                 [this](const typename sw_watchdog_msgs::msg::Heartbeat::SharedPtr msg) -> void {
-                    RCLCPP_INFO(get_logger(), "Watchdog raised, heartbeat sent at [%d.x]", msg->stamp.sec);
-                    lease_misses_ = 0;
+                    if(!realtime_)
+                        RCLCPP_INFO(get_logger(), "Watchdog raised, heartbeat sent at [%d.x]", msg->stamp.sec);
+                    // Only the newest heartbeat matters; take the rest of a burst in this wakeup
+                    bool departing = msg->departing;
+                    uint64_t progress = msg->progress;
+                    int64_t input_age_ns = msg->input_age_ns;
+                    if(msg->metrics.valid)
+                        metrics_ = msg->metrics;
+                    rclcpp::MessageInfo info;
+                    for(std::size_t count = 1;
+                        count < MAX_HEARTBEAT_BATCH && heartbeat_sub_->take(heartbeat_msg_, info);
+                        ++count) {
+                        departing = heartbeat_msg_.departing;
+                        progress = heartbeat_msg_.progress;
+                        input_age_ns = heartbeat_msg_.input_age_ns;
+                        if(heartbeat_msg_.metrics.valid)
+                            metrics_ = heartbeat_msg_.metrics;
+                    }
+                    lease_misses_.store(0, std::memory_order_relaxed);
+                    if(missing_) {
+                        // Recovery after missed leases counts as a transition as well
+                        const WatchdogConfig * config = config_.read();
+                        const int64_t now_ns = this->get_clock()->now().nanoseconds();
+                        if(config->flap.enabled() && flap_transition(flap_, config->flap, now_ns) &&
+                           enable_pub_)
+                            publish_status(0);
+                        missing_ = false;
+                    }
+                    departed_.store(departing, std::memory_order_release);
+                    armed_.store(true, std::memory_order_release);
+                    if(progress)
+                        check_progress(progress);
+                    if(input_age_ns >= 0)
+                        check_input_age(input_age_ns);
+                    if(departing && !realtime_)
+                        RCLCPP_INFO(get_logger(), "Watched entity announced its departure");
+                    config_.quiescent_state();
                 },
                 heartbeat_sub_options_);
         }
 
+        if(!startup_timer_ && config_.read()->startup_deadline.count() > 0)
+            startup_timer_ = create_wall_timer(config_.read()->startup_deadline, [this]() -> void {
+                startup_timer_->cancel();
+                if(armed_.load(std::memory_order_acquire))
+                    return;
+                if(!realtime_)
+                    RCLCPP_INFO(get_logger(),
+                                "Watched entity did not appear within the startup deadline");
+                if(enable_pub_)
+                    publish_status(0, true);
+                deactivate();
+            });
+        config_.quiescent_state();
+
         // Starting from this point, all messages are sent to the network.
         if (enable_pub_)
             status_pub_->on_activate();
@@ -199,6 +469,9 @@ public:
     {
         heartbeat_sub_.reset(); // XXX there does not seem to be a 'deactivate' for subscribers.
         heartbeat_sub_ = nullptr;
+        startup_timer_.reset();
+        // The next activation waits for a first heartbeat again
+        armed_.store(false, std::memory_order_release);
 
         // Starting from this point, all messages are no longer sent to the network.
         if(enable_pub_)
@@ -233,9 +506,12 @@ public:
     }
 
 private:
-    /// The lease duration granted to the remote (heartbeat) publisher
-    std::chrono::milliseconds lease_duration_;
+    /// Runtime configuration (lease, max misses), swapped as a whole when parameters change
+    RcuCell<WatchdogConfig> config_;
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_cb_handle_;
     rclcpp::Subscription<sw_watchdog_msgs::msg::Heartbeat>::SharedPtr heartbeat_sub_ = nullptr;
+    /// One-shot check for the first heartbeat at the startup deadline
+    rclcpp::TimerBase::SharedPtr startup_timer_;
     /// Publish lease expiry for the watched entity
     // By default, a lifecycle publisher is inactive by creation and has to be activated to publish.
     std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sw_watchdog_msgs::msg::Status>> status_pub_ = nullptr;
@@ -243,14 +519,35 @@ private:
     bool autostart_;
     /// Whether a lease expiry should be published
     bool enable_pub_;
+    /// Whether the active state has to stay free of allocations and blocking I/O
+    bool realtime_ = false;
+    /// Preallocated status message, reused for every publication
+    sw_watchdog_msgs::msg::Status status_msg_;
     /// Topic name for heartbeat signal by the watched entity
     const std::string topic_name_;
     /// The number of lease misses since the last heartbeat was received
-    std::atomic<uint16_t> lease_misses_;
-    /// The maximum number of lease misses granted to the watched entity
-    uint16_t max_misses_;
+    // Both writers run in the node's default, mutually exclusive callback group, so a single
+    // atomic never sees contention.
+    std::atomic<uint64_t> lease_misses_{0};
+    /// Whether the watched entity announced a planned shutdown with its last heartbeat
+    std::atomic<bool> departed_{false};
+    /// Whether a heartbeat has been received since activation; leases are enforced from then on
+    std::atomic<bool> armed_{false};
+    /// Whether leases have been missed since the last heartbeat, and the resulting flap score
+    bool missing_ = false;
+    FlapState flap_;
+    /// Progress counter of the watched entity, when it last advanced and whether it is stuck
+    uint64_t progress_ = 0;
+    int64_t progress_ns_ = 0;
+    bool stuck_ = false;
+    /// Whether the newest reported input age exceeds the maximum input age
+    bool stale_ = false;
+    /// Most recent load figures of the watched entity, reported along with its failures
+    sw_watchdog_msgs::msg::SourceMetrics metrics_;
     rclcpp::QoS qos_profile_;
     rclcpp::SubscriptionOptions heartbeat_sub_options_;
+    /// Reused storage for heartbeats taken directly from the reader
+    sw_watchdog_msgs::msg::Heartbeat heartbeat_msg_;
 };
 
 } // namespace sw_watchdog
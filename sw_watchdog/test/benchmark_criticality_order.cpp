@@ -0,0 +1,108 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Per criticality class latency of a backlogged heartbeat batch, processed in arrival order or
+// most critical class first. A batch holds 256 heartbeats of which one in sixteen comes from a
+// top-class source; the latency of a heartbeat is the time from the wakeup that took the batch
+// to the update of its source state. mean_top_ns and mean_low_ns report the top class (3) and
+// the default class (0); maxima are left out as they only show preemption of the benchmark.
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "sw_watchdog/criticality.hpp"
+#include "sw_watchdog/source_table.hpp"
+
+namespace
+{
+
+using sw_watchdog::CRITICALITY_LEVELS;
+
+constexpr std::size_t BATCH = 256;
+constexpr uint16_t SOURCES = 1024;
+constexpr int64_t LEASE_NS = 100000000;
+
+class Backlog
+{
+public:
+    Backlog()
+    {
+        sources_.reset(SOURCES);
+        for(uint16_t id = 0; id < SOURCES; ++id) {
+            const uint8_t level = id % 16 == 0 ? CRITICALITY_LEVELS - 1 : id % 3;
+            sources_.get_or_insert(id, 0, LEASE_NS * 10)->criticality = level;
+        }
+    }
+
+    /// Take the next batch and process it, in class order or in arrival order
+    void wakeup(bool class_ordered)
+    {
+        const auto wakeup = std::chrono::steady_clock::now();
+        const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            wakeup.time_since_epoch()).count();
+        for(std::size_t i = 0; i < BATCH; ++i) {
+            const uint16_t id = static_cast<uint16_t>((next_ + i) % SOURCES);
+            const uint8_t level = class_ordered ? sources_.find(id)->criticality : 0;
+            class_order_[level][class_size_[level]++] = id;
+        }
+        next_ = (next_ + BATCH) % SOURCES;
+        for(std::size_t level = CRITICALITY_LEVELS; level-- > 0; ) {
+            for(std::size_t i = 0; i < class_size_[level]; ++i) {
+                sw_watchdog::SourceState * source = sources_.find(class_order_[level][i]);
+                source->last_seen_ns = now_ns;
+                source->deadline_ns = now_ns + LEASE_NS;
+                ++source->beats;
+                sources_.update_health(*source, source->deadline_ns);
+                latencies_[source->criticality].record(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wakeup).count());
+            }
+            class_size_[level] = 0;
+        }
+    }
+
+    const sw_watchdog::CriticalityLatencies & latencies() const { return latencies_; }
+
+private:
+    sw_watchdog::SourceTable sources_;
+    std::array<std::array<uint16_t, BATCH>, CRITICALITY_LEVELS> class_order_;
+    std::array<std::size_t, CRITICALITY_LEVELS> class_size_ = {};
+    sw_watchdog::CriticalityLatencies latencies_;
+    std::size_t next_ = 0;
+};
+
+void run_backlog(benchmark::State & state, bool class_ordered)
+{
+    Backlog backlog;
+    for(auto _ : state)
+        backlog.wakeup(class_ordered);
+    const sw_watchdog::ClassLatency & top = backlog.latencies()[CRITICALITY_LEVELS - 1];
+    const sw_watchdog::ClassLatency & low = backlog.latencies()[0];
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.counters["mean_top_ns"] = top.mean_ns();
+    state.counters["mean_low_ns"] = low.mean_ns();
+}
+
+void BM_BacklogFifo(benchmark::State & state) { run_backlog(state, false); }
+void BM_BacklogClassOrdered(benchmark::State & state) { run_backlog(state, true); }
+
+} // anonymous ns
+
+BENCHMARK(BM_BacklogFifo);
+BENCHMARK(BM_BacklogClassOrdered);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,176 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Executor cost of heartbeats at 10k, 50k and 100k beats/s, offered by 1000 sources through a real
+// subscription. For one second per iteration, a publisher sends a burst every millisecond while a
+// SingleThreadedExecutor spins the watcher on its own thread. With one dispatch per beat the
+// executor waits, collects the ready entities, allocates a message and takes it for every
+// heartbeat; the drained watcher takes the rest of the burst from the reader in the same callback
+// and reads the clock once, as SimpleWatchdog does. Both update the source table per beat.
+// core_pct is the CPU time of the executor thread per second of traffic, ns_per_beat that time per
+// received beat, dispatches_per_beat the executor dispatches per received beat and lost_pct the
+// share of beats that did not arrive, e.g. because the reader queue overflowed.
+
+#include <benchmark/benchmark.h>
+
+#include <pthread.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "sw_watchdog_msgs/msg/heartbeat.hpp"
+#include "sw_watchdog/source_table.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr uint16_t SOURCES = 1000;
+constexpr int64_t BURSTS_PER_S = 1000;
+constexpr int64_t LEASE_NS = 100000000;
+/// Reader queue, deep enough for the bursts of 100 ms at the highest rate
+constexpr std::size_t QUEUE_DEPTH = 10000;
+
+/// Subscriber that updates the source table, per dispatched beat or per drained burst
+class Watcher : public rclcpp::Node
+{
+public:
+    explicit Watcher(bool drained)
+        : Node("watcher")
+    {
+        sources_.reset(SOURCES);
+        subscription_ = create_subscription<sw_watchdog_msgs::msg::Heartbeat>(
+            "heartbeat", rclcpp::QoS(QUEUE_DEPTH).reliable(),
+            [this, drained](const sw_watchdog_msgs::msg::Heartbeat::SharedPtr msg) {
+                ++dispatches_;
+                const int64_t now_ns = get_clock()->now().nanoseconds();
+                handle(*msg, now_ns);
+                if(!drained)
+                    return;
+                rclcpp::MessageInfo info;
+                while(subscription_->take(taken_, info))
+                    handle(taken_, now_ns);
+            });
+    }
+
+    uint64_t received() const { return received_.load(); }
+    uint64_t dispatches() const { return dispatches_.load(); }
+
+private:
+    void handle(const sw_watchdog_msgs::msg::Heartbeat & beat, int64_t now_ns)
+    {
+        sw_watchdog::SourceState * source =
+            sources_.get_or_insert(beat.checkpoint_id, now_ns, LEASE_NS * 10);
+        if(source) {
+            source->last_seen_ns = now_ns;
+            source->deadline_ns = now_ns + LEASE_NS;
+            source->expired = false;
+            ++source->beats;
+            sources_.update_health(*source, source->deadline_ns);
+        }
+        received_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    rclcpp::Subscription<sw_watchdog_msgs::msg::Heartbeat>::SharedPtr subscription_;
+    sw_watchdog_msgs::msg::Heartbeat taken_;
+    sw_watchdog::SourceTable sources_;
+    std::atomic<uint64_t> received_{0};
+    std::atomic<uint64_t> dispatches_{0};
+};
+
+/// CPU time the given thread has consumed so far
+std::chrono::nanoseconds thread_cpu_time(std::thread & thread)
+{
+    clockid_t clock;
+    pthread_getcpuclockid(thread.native_handle(), &clock);
+    timespec time;
+    clock_gettime(clock, &time);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+/// One iteration offers the beats of one second at the given rate
+void run_rate(benchmark::State & state, bool drained)
+{
+    const int64_t rate = state.range(0);
+    const int64_t burst = rate / BURSTS_PER_S;
+    rclcpp::init(0, nullptr);
+    {
+        auto watcher = std::make_shared<Watcher>(drained);
+        auto sender = std::make_shared<rclcpp::Node>("sender");
+        auto publisher = sender->create_publisher<sw_watchdog_msgs::msg::Heartbeat>(
+            "heartbeat", rclcpp::QoS(QUEUE_DEPTH).reliable());
+        rclcpp::executors::SingleThreadedExecutor executor;
+        executor.add_node(watcher);
+        std::thread spinner([&executor]() { executor.spin(); });
+        // Matching publisher and subscription
+        std::this_thread::sleep_for(500ms);
+
+        sw_watchdog_msgs::msg::Heartbeat message;
+        uint64_t sent = 0;
+        std::chrono::nanoseconds busy{0};
+        const uint64_t dispatches_before = watcher->dispatches();
+        const uint64_t received_before = watcher->received();
+        for(auto _ : state) {
+            const std::chrono::nanoseconds cpu_start = thread_cpu_time(spinner);
+            auto next_burst = std::chrono::steady_clock::now();
+            for(int64_t b = 0; b < BURSTS_PER_S; ++b) {
+                for(int64_t i = 0; i < burst; ++i) {
+                    message.checkpoint_id = static_cast<uint16_t>(sent++ % SOURCES);
+                    publisher->publish(message);
+                }
+                next_burst += 1ms;
+                std::this_thread::sleep_until(next_burst);
+            }
+            // Let the executor catch up with what is still queued
+            const auto deadline = std::chrono::steady_clock::now() + 1s;
+            while(watcher->received() - received_before < sent &&
+                  std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(1ms);
+            busy += thread_cpu_time(spinner) - cpu_start;
+        }
+        executor.cancel();
+        spinner.join();
+
+        const double received = static_cast<double>(watcher->received() - received_before);
+        const double busy_ns = static_cast<double>(busy.count());
+        state.SetItemsProcessed(static_cast<int64_t>(received));
+        state.counters["ns_per_beat"] = received > 0 ? busy_ns / received : 0.0;
+        state.counters["core_pct"] = 100.0 * busy_ns / 1e9 /
+            static_cast<double>(state.iterations());
+        state.counters["dispatches_per_beat"] = received > 0 ?
+            static_cast<double>(watcher->dispatches() - dispatches_before) / received : 0.0;
+        state.counters["lost_pct"] = sent > 0 ?
+            100.0 * (1.0 - received / static_cast<double>(sent)) : 0.0;
+    }
+    rclcpp::shutdown();
+}
+
+void BM_DispatchDrained(benchmark::State & state) { run_rate(state, true); }
+void BM_DispatchPerBeat(benchmark::State & state) { run_rate(state, false); }
+
+} // anonymous ns
+
+BENCHMARK(BM_DispatchDrained)->Arg(10000)->Arg(50000)->Arg(100000)->Iterations(3)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DispatchPerBeat)->Arg(10000)->Arg(50000)->Arg(100000)->Iterations(3)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,147 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cost of taking heartbeats into the source table at 10k, 50k and 100k beats/s, offered by 1000
+// sources. The executor is assumed to wake up once per millisecond; a drained wakeup handles all
+// beats that arrived since the previous one, reading the configuration and the clock once, while
+// a per-beat dispatch repeats both for every heartbeat. Each beat is filtered on its serialized
+// checkpoint id and updates its source state and health rank; the rmw take and deserialization
+// are not part of the measurement, nor is the executor, see benchmark_heartbeat_dispatch for
+// that. core_pct is the share of one core spent at the offered rate.
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "sw_watchdog/cdr.hpp"
+#include "sw_watchdog/criticality.hpp"
+#include "sw_watchdog/rcu.hpp"
+#include "sw_watchdog/source_table.hpp"
+#include "sw_watchdog/watchdog_config.hpp"
+
+namespace
+{
+
+constexpr uint16_t SOURCES = 1000;
+constexpr int64_t WAKEUPS_PER_S = 1000;
+constexpr int64_t LEASE_NS = 100000000;
+
+/// Serialized (XCDR1, little endian) heartbeat prefix up to and including the checkpoint id
+std::vector<uint8_t> serialize_heartbeat(uint16_t checkpoint_id)
+{
+    std::vector<uint8_t> buffer = {0x00, 0x01, 0x00, 0x00};
+    const auto put = [&buffer](const void * data, std::size_t size) {
+        const std::size_t offset = buffer.size();
+        buffer.resize(offset + size);
+        std::memcpy(buffer.data() + offset, data, size);
+    };
+    const int32_t sec = 1;
+    const uint32_t nanosec = 0, frame_id_size = 1;
+    put(&sec, 4);
+    put(&nanosec, 4);
+    put(&frame_id_size, 4);
+    buffer.push_back(0);
+    buffer.resize(4 + ((buffer.size() - 4 + 3) & ~std::size_t(3)));
+    put(&sec, 4);
+    put(&nanosec, 4);
+    put(&checkpoint_id, 2);
+    buffer.resize(buffer.size() + 64);
+    return buffer;
+}
+
+class Ingest
+{
+public:
+    Ingest()
+        : config_(std::make_unique<const sw_watchdog::WatchdogConfig>())
+    {
+        sources_.reset(SOURCES);
+        for(uint16_t id = 0; id < SOURCES; ++id)
+            beats_.push_back(serialize_heartbeat(id));
+    }
+
+    /// Handle count heartbeats, in groups of batch per wakeup
+    void run(std::size_t count, std::size_t batch)
+    {
+        for(std::size_t taken = 0; taken < count; taken += batch)
+            wakeup(batch);
+    }
+
+private:
+    void wakeup(std::size_t batch)
+    {
+        const auto wakeup = std::chrono::steady_clock::now();
+        const sw_watchdog::WatchdogConfig * config = config_.read();
+        const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            wakeup.time_since_epoch()).count();
+        for(std::size_t i = 0; i < batch; ++i) {
+            const std::vector<uint8_t> & beat = beats_[next_];
+            next_ = (next_ + 1) % SOURCES;
+            uint16_t checkpoint_id;
+            if(!sw_watchdog::peek_heartbeat_checkpoint_id(beat.data(), beat.size(),
+                                                          &checkpoint_id) ||
+               !config->in_shard(checkpoint_id))
+                continue;
+            sw_watchdog::SourceState * source =
+                sources_.get_or_insert(checkpoint_id, now_ns, LEASE_NS * 10);
+            source->last_seen_ns = now_ns;
+            source->deadline_ns = now_ns + LEASE_NS;
+            source->expired = false;
+            ++source->beats;
+            sources_.update_health(*source, source->deadline_ns);
+            latencies_[source->criticality].record(std::chrono::duration_cast<
+                std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wakeup).count());
+        }
+        config_.quiescent_state();
+    }
+
+    sw_watchdog::RcuCell<sw_watchdog::WatchdogConfig> config_;
+    sw_watchdog::SourceTable sources_;
+    sw_watchdog::CriticalityLatencies latencies_;
+    std::vector<std::vector<uint8_t>> beats_;
+    std::size_t next_ = 0;
+};
+
+/// One iteration handles the beats of one second at the offered rate
+void run_rate(benchmark::State & state, bool drained)
+{
+    const std::size_t rate = static_cast<std::size_t>(state.range(0));
+    const std::size_t batch = drained ? rate / WAKEUPS_PER_S : 1;
+    Ingest ingest;
+    std::chrono::steady_clock::duration busy{0};
+    for(auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        ingest.run(rate, batch);
+        busy += std::chrono::steady_clock::now() - start;
+    }
+    const double busy_s = std::chrono::duration<double>(busy).count();
+    const double beats = static_cast<double>(state.iterations() * rate);
+    state.SetItemsProcessed(state.iterations() * rate);
+    state.counters["ns_per_beat"] = busy_s * 1e9 / beats;
+    state.counters["core_pct"] = 100.0 * busy_s / static_cast<double>(state.iterations());
+}
+
+void BM_IngestDrained(benchmark::State & state) { run_rate(state, true); }
+void BM_IngestPerBeat(benchmark::State & state) { run_rate(state, false); }
+
+} // anonymous ns
+
+BENCHMARK(BM_IngestDrained)->Arg(10000)->Arg(50000)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IngestPerBeat)->Arg(10000)->Arg(50000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,50 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contention on the lease miss counter: one atomic shared by all threads against the sharded
+// counter, from 1 to 16 threads adding concurrently.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "sw_watchdog/sharded_counter.hpp"
+
+namespace
+{
+
+std::atomic<uint64_t> shared_counter{0};
+sw_watchdog::ShardedCounter<> sharded_counter;
+
+void BM_SharedAtomic(benchmark::State & state)
+{
+    for(auto _ : state)
+        shared_counter.fetch_add(1, std::memory_order_relaxed);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ShardedCounter(benchmark::State & state)
+{
+    for(auto _ : state)
+        sharded_counter.add(1);
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // anonymous ns
+
+BENCHMARK(BM_SharedAtomic)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_ShardedCounter)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,99 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Lookup of statically configured checkpoint ids: the minimal perfect hash of SlotIndex, its
+// open-addressing table that all other ids go to, and the std::map the watchdog used before the
+// source table. 200 configured ids from the upper id range, so none of them is dense, are looked
+// up in a random order. With argument 0 they are random, with 1 they are chosen to share a few
+// home buckets of the probing table, its worst case.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "sw_watchdog/source_table.hpp"
+
+namespace
+{
+
+constexpr std::size_t CONFIGURED = 200;
+constexpr std::size_t LOOKUPS = 4096;
+
+struct Ids
+{
+    explicit Ids(bool clustered)
+    {
+        std::mt19937 random(1);
+        std::set<uint16_t> distinct;
+        while(distinct.size() < CONFIGURED) {
+            const uint16_t id =
+                static_cast<uint16_t>(CONFIGURED + random() % (UINT16_MAX - CONFIGURED));
+            // Home bucket as computed by SlotIndex, whose table has 512 buckets here
+            if(!clustered || ((static_cast<uint32_t>(id) * 2654435769u >> 8) & 511) < 4)
+                distinct.insert(id);
+        }
+        configured.assign(distinct.begin(), distinct.end());
+        for(std::size_t i = 0; i < LOOKUPS; ++i)
+            lookups.push_back(configured[random() % CONFIGURED]);
+    }
+
+    std::vector<uint16_t> configured;
+    std::vector<uint16_t> lookups;
+};
+
+const Ids & ids(int64_t clustered)
+{
+    static const Ids spread(false), dense_homes(true);
+    return clustered ? dense_homes : spread;
+}
+
+void run_slot_index(benchmark::State & state, bool perfect)
+{
+    const Ids & ids = ::ids(state.range(0));
+    sw_watchdog::SlotIndex index;
+    index.reset(CONFIGURED, perfect ? ids.configured : std::vector<uint16_t>());
+    for(std::size_t i = 0; i < CONFIGURED; ++i)
+        index.insert(ids.configured[i], static_cast<uint32_t>(i));
+    for(auto _ : state)
+        for(const uint16_t id : ids.lookups)
+            benchmark::DoNotOptimize(index.find(id));
+    state.SetItemsProcessed(state.iterations() * LOOKUPS);
+}
+
+void BM_PerfectHash(benchmark::State & state) { run_slot_index(state, true); }
+void BM_LinearProbing(benchmark::State & state) { run_slot_index(state, false); }
+
+void BM_StdMap(benchmark::State & state)
+{
+    const Ids & ids = ::ids(state.range(0));
+    std::map<uint16_t, uint32_t> index;
+    for(std::size_t i = 0; i < CONFIGURED; ++i)
+        index.emplace(ids.configured[i], static_cast<uint32_t>(i));
+    for(auto _ : state)
+        for(const uint16_t id : ids.lookups)
+            benchmark::DoNotOptimize(index.find(id));
+    state.SetItemsProcessed(state.iterations() * LOOKUPS);
+}
+
+} // anonymous ns
+
+BENCHMARK(BM_PerfectHash)->Arg(0)->Arg(1);
+BENCHMARK(BM_LinearProbing)->Arg(0)->Arg(1);
+BENCHMARK(BM_StdMap)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,128 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A SimpleHeartbeat driven by a ProgressExecutor must fall silent while any callback of that
+// executor blocks, and a SimpleWatchdog spinning elsewhere must report its checkpoint. Both
+// components are loaded from the package library like a component container does.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "class_loader/class_loader.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/node_factory.hpp"
+
+#include "sw_watchdog_msgs/msg/heartbeat.hpp"
+#include "sw_watchdog_msgs/msg/status.hpp"
+#include "sw_watchdog/executor_progress.hpp"
+#include "sw_watchdog/progress_executor.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr uint16_t CHECKPOINT_ID = 42;
+
+/// Wait until condition holds or timeout passes, returns the condition
+template<typename F>
+bool wait_for(F && condition, std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(!condition()) {
+        if(std::chrono::steady_clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_for(5ms);
+    }
+    return true;
+}
+
+} // anonymous ns
+
+TEST(BlockedExecutor, HeartbeatStopsAndWatchdogReportsTheSource)
+{
+    rclcpp::init(0, nullptr);
+    class_loader::ClassLoader loader(SW_WATCHDOG_LIBRARY);
+    const auto create = [&loader](const std::string & plugin, const rclcpp::NodeOptions & options) {
+        const auto factory = loader.createInstance<rclcpp_components::NodeFactory>(
+            "rclcpp_components::NodeFactoryTemplate<" + plugin + ">");
+        return factory->create_node_instance(options);
+    };
+
+    // Watchdog side: the watchdog and an observer of heartbeats and failures
+    rclcpp_components::NodeInstanceWrapper watchdog = create(
+        "sw_watchdog::SimpleWatchdog",
+        rclcpp::NodeOptions().arguments({"simple_watchdog", "100", "--publish", "--activate"}));
+    auto observer = std::make_shared<rclcpp::Node>("observer");
+    std::atomic<uint64_t> beats{0};
+    std::atomic<bool> reported{false};
+    auto heartbeat_sub = observer->create_subscription<sw_watchdog_msgs::msg::Heartbeat>(
+        "heartbeat", 10, [&beats](const sw_watchdog_msgs::msg::Heartbeat::SharedPtr msg) {
+            if(msg->checkpoint_id == CHECKPOINT_ID)
+                ++beats;
+        });
+    auto failure_sub = observer->create_subscription<sw_watchdog_msgs::msg::Status>(
+        "failure", 10, [&reported](const sw_watchdog_msgs::msg::Status::SharedPtr msg) {
+            if(msg->checkpoint_id == CHECKPOINT_ID)
+                reported = true;
+        });
+    rclcpp::executors::SingleThreadedExecutor watchdog_executor;
+    watchdog_executor.add_node(watchdog.get_node_base_interface());
+    watchdog_executor.add_node(observer);
+    std::thread watchdog_thread([&watchdog_executor]() { watchdog_executor.spin(); });
+
+    // Heartbeat side: a node whose timer callback blocks on demand shares the executor
+    auto busy = std::make_shared<rclcpp::Node>("busy");
+    std::atomic<bool> block{false};
+    auto busy_timer = busy->create_wall_timer(10ms, [&block]() {
+        while(block.load())
+            std::this_thread::sleep_for(1ms);
+    });
+    sw_watchdog::ProgressExecutor heartbeat_executor;
+    heartbeat_executor.add_node(busy);
+    std::thread heartbeat_thread([&heartbeat_executor]() { heartbeat_executor.spin(); });
+    // Executor-driven beats are only taken up by a spinning ProgressExecutor
+    ASSERT_TRUE(wait_for([]() { return sw_watchdog::executor_progress().attached(); }, 1000ms));
+    rclcpp::NodeOptions heartbeat_options;
+    heartbeat_options.parameter_overrides({
+        rclcpp::Parameter("period", 20),
+        rclcpp::Parameter("checkpoint_id", static_cast<int>(CHECKPOINT_ID)),
+        rclcpp::Parameter("executor_driven", true)});
+    rclcpp_components::NodeInstanceWrapper heartbeat =
+        create("sw_watchdog::SimpleHeartbeat", heartbeat_options);
+    heartbeat_executor.add_node(heartbeat.get_node_base_interface());
+
+    EXPECT_TRUE(wait_for([&beats]() { return beats.load() >= 5; }, 2000ms));
+    EXPECT_FALSE(reported.load());
+
+    block = true;
+    // At most a beat already on its way may still arrive
+    std::this_thread::sleep_for(50ms);
+    const uint64_t beats_when_blocked = beats.load();
+    EXPECT_TRUE(wait_for([&reported]() { return reported.load(); }, 2000ms));
+    EXPECT_EQ(beats.load(), beats_when_blocked);
+
+    block = false;
+    heartbeat_executor.cancel();
+    watchdog_executor.cancel();
+    heartbeat_thread.join();
+    watchdog_thread.join();
+    rclcpp::shutdown();
+}
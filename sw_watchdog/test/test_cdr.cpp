@@ -0,0 +1,110 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sw_watchdog/cdr.hpp"
+
+namespace
+{
+
+/// Serialize the leading fields of a Heartbeat the way an XCDR1 writer does
+std::vector<uint8_t> serialize_heartbeat(uint16_t checkpoint_id, const std::string & frame_id,
+                                         bool little_endian = true)
+{
+    std::vector<uint8_t> buffer = {0x00, static_cast<uint8_t>(little_endian ? 0x01 : 0x00), 0, 0};
+    const auto put = [&buffer, little_endian](uint32_t value, std::size_t size) {
+        // Primitives are aligned to their size, relative to the end of the encapsulation header
+        while((buffer.size() - 4) % size)
+            buffer.push_back(0);
+        for(std::size_t i = 0; i < size; ++i) {
+            const std::size_t shift = 8 * (little_endian ? i : size - 1 - i);
+            buffer.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    };
+    put(12, 4);                                            // header.stamp.sec
+    put(345, 4);                                           // header.stamp.nanosec
+    put(static_cast<uint32_t>(frame_id.size() + 1), 4);    // header.frame_id
+    buffer.insert(buffer.end(), frame_id.begin(), frame_id.end());
+    buffer.push_back(0);
+    put(12, 4);                                            // stamp.sec
+    put(345, 4);                                           // stamp.nanosec
+    put(checkpoint_id, 2);
+    return buffer;
+}
+
+} // anonymous ns
+
+TEST(Cdr, PeeksCheckpointIdBehindAnyFrameId)
+{
+    // Frame ids of every length modulo 4 shift the following fields into alignment padding
+    for(const std::string frame_id : {"", "a", "ab", "abc", "abcd", "base_link"}) {
+        const std::vector<uint8_t> buffer = serialize_heartbeat(4711, frame_id);
+        uint16_t checkpoint_id = 0;
+        EXPECT_TRUE(sw_watchdog::peek_heartbeat_checkpoint_id(buffer.data(), buffer.size(),
+                                                              &checkpoint_id)) << frame_id;
+        EXPECT_EQ(checkpoint_id, 4711u) << frame_id;
+    }
+}
+
+TEST(Cdr, PeeksBigEndianBuffers)
+{
+    const std::vector<uint8_t> buffer = serialize_heartbeat(0x1234, "map", false);
+    uint16_t checkpoint_id = 0;
+    ASSERT_TRUE(sw_watchdog::peek_heartbeat_checkpoint_id(buffer.data(), buffer.size(),
+                                                          &checkpoint_id));
+    EXPECT_EQ(checkpoint_id, 0x1234u);
+    int64_t stamp_ns = 0;
+    ASSERT_TRUE(sw_watchdog::peek_header_stamp(buffer.data(), buffer.size(), &stamp_ns));
+    EXPECT_EQ(stamp_ns, 12000000345);
+}
+
+TEST(Cdr, RejectsTruncatedBuffers)
+{
+    const std::vector<uint8_t> buffer = serialize_heartbeat(7, "odom");
+    uint16_t checkpoint_id;
+    for(std::size_t length = 0; length < buffer.size(); ++length)
+        EXPECT_FALSE(sw_watchdog::peek_heartbeat_checkpoint_id(buffer.data(), length,
+                                                               &checkpoint_id)) << length;
+    EXPECT_FALSE(sw_watchdog::peek_heartbeat_checkpoint_id(nullptr, 0, &checkpoint_id));
+}
+
+TEST(Cdr, RejectsOversizedStringAndUnknownEncapsulation)
+{
+    std::vector<uint8_t> buffer = serialize_heartbeat(7, "odom");
+    uint16_t checkpoint_id;
+    std::vector<uint8_t> oversized = buffer;
+    const uint32_t huge = UINT32_MAX;
+    std::memcpy(oversized.data() + 12, &huge, sizeof(huge));
+    EXPECT_FALSE(sw_watchdog::peek_heartbeat_checkpoint_id(oversized.data(), oversized.size(),
+                                                           &checkpoint_id));
+    // XCDR2 and parameter list encapsulations are not understood
+    buffer[1] = 0x07;
+    EXPECT_FALSE(sw_watchdog::peek_heartbeat_checkpoint_id(buffer.data(), buffer.size(),
+                                                           &checkpoint_id));
+}
+
+TEST(Cdr, RejectsStampWithInvalidNanoseconds)
+{
+    std::vector<uint8_t> buffer = serialize_heartbeat(7, "");
+    const uint32_t nanosec = 1000000000u;
+    std::memcpy(buffer.data() + 8, &nanosec, sizeof(nanosec));
+    int64_t stamp_ns;
+    EXPECT_FALSE(sw_watchdog::peek_header_stamp(buffer.data(), buffer.size(), &stamp_ns));
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "sw_watchdog/checkpoint_ids.hpp"
+
+using sw_watchdog::CheckpointRegistry;
+
+TEST(CheckpointRegistry, NameKeepsItsId)
+{
+    CheckpointRegistry registry;
+    uint16_t a, b, again;
+    ASSERT_TRUE(registry.assign("/a", &a));
+    ASSERT_TRUE(registry.assign("/b", &b));
+    ASSERT_TRUE(registry.assign("/a", &again));
+    EXPECT_EQ(a, 0u);
+    EXPECT_EQ(b, 1u);
+    EXPECT_EQ(again, a);
+    EXPECT_EQ(registry.size(), 2u);
+}
+
+TEST(CheckpointRegistry, IdsSeenInHeartbeatsAreNotHandedOut)
+{
+    CheckpointRegistry registry;
+    registry.reserve(3);
+    registry.reserve(1);
+    uint16_t id;
+    ASSERT_TRUE(registry.assign("/new", &id));
+    EXPECT_EQ(id, 4u);
+    // Name-derived ids live in their own half of the id space
+    registry.reserve(sw_watchdog::checkpoint_id_from_name("/fallback"));
+    ASSERT_TRUE(registry.assign("/newer", &id));
+    EXPECT_EQ(id, 5u);
+}
+
+TEST(CheckpointRegistry, ExhaustedBelowTheHashedIds)
+{
+    CheckpointRegistry registry;
+    registry.reserve(sw_watchdog::HASHED_CHECKPOINT_ID_BASE - 1);
+    uint16_t id;
+    EXPECT_FALSE(registry.assign("/late", &id));
+    EXPECT_GE(sw_watchdog::checkpoint_id_from_name("/late"), sw_watchdog::HASHED_CHECKPOINT_ID_BASE);
+}
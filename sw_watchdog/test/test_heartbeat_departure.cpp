@@ -0,0 +1,102 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The simple_heartbeat executable must announce its departure when it is interrupted, on every
+// supported rclcpp version, so that the watchdog does not wait out a full lease.
+
+#include <gtest/gtest.h>
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "sw_watchdog_msgs/msg/heartbeat.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr uint16_t CHECKPOINT_ID = 43;
+
+/// Spin executor until condition holds or timeout passes, returns the condition
+template<typename F>
+bool spin_until(rclcpp::Executor & executor, F && condition, std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(!condition()) {
+        if(std::chrono::steady_clock::now() >= deadline)
+            return false;
+        executor.spin_some();
+        std::this_thread::sleep_for(5ms);
+    }
+    return true;
+}
+
+} // anonymous ns
+
+TEST(HeartbeatDeparture, InterruptedExecutableDeparts)
+{
+    // Started before rclcpp, so no middleware thread is around at the fork
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if(pid == 0) {
+        execl(SIMPLE_HEARTBEAT_EXECUTABLE, SIMPLE_HEARTBEAT_EXECUTABLE, "--ros-args",
+              "-p", "period:=20", "-p", "checkpoint_id:=43", static_cast<char *>(nullptr));
+        _exit(127);
+    }
+
+    rclcpp::init(0, nullptr);
+    auto observer = std::make_shared<rclcpp::Node>("observer");
+    std::atomic<uint64_t> beats{0};
+    std::atomic<bool> departed{false};
+    auto heartbeat_sub = observer->create_subscription<sw_watchdog_msgs::msg::Heartbeat>(
+        "heartbeat", 10,
+        [&beats, &departed](const sw_watchdog_msgs::msg::Heartbeat::SharedPtr msg) {
+            if(msg->checkpoint_id != CHECKPOINT_ID)
+                return;
+            if(msg->departing)
+                departed = true;
+            else
+                ++beats;
+        });
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(observer);
+
+    EXPECT_TRUE(spin_until(executor, [&beats]() { return beats.load() >= 3; }, 5000ms));
+    ASSERT_EQ(kill(pid, SIGINT), 0);
+    EXPECT_TRUE(spin_until(executor, [&departed]() { return departed.load(); }, 2000ms));
+
+    int status = 0;
+    const auto deadline = std::chrono::steady_clock::now() + 2000ms;
+    while(waitpid(pid, &status, WNOHANG) == 0) {
+        if(std::chrono::steady_clock::now() >= deadline) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            break;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    rclcpp::shutdown();
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "sw_watchdog/perfect_hash.hpp"
+
+using sw_watchdog::PerfectHash;
+
+TEST(PerfectHash, MapsEveryIdToADistinctIndex)
+{
+    std::mt19937 random(3);
+    for(const std::size_t size : {1u, 2u, 3u, 17u, 100u, 1000u, 30000u}) {
+        std::set<uint16_t> distinct;
+        while(distinct.size() < size)
+            distinct.insert(static_cast<uint16_t>(random()));
+        const std::vector<uint16_t> ids(distinct.begin(), distinct.end());
+        PerfectHash hash;
+        ASSERT_TRUE(hash.build(ids)) << size;
+        EXPECT_EQ(hash.size(), size);
+        std::vector<bool> taken(size, false);
+        for(const uint16_t id : ids) {
+            const uint32_t index = hash.index(id);
+            ASSERT_LT(index, size);
+            EXPECT_FALSE(taken[index]) << "id " << id << " of " << size;
+            taken[index] = true;
+        }
+    }
+}
+
+TEST(PerfectHash, UnknownIdsStayInRange)
+{
+    PerfectHash hash;
+    ASSERT_TRUE(hash.build({100, 2000, 30000}));
+    for(uint32_t id = 0; id <= UINT16_MAX; id += 97)
+        EXPECT_LT(hash.index(static_cast<uint16_t>(id)), 3u);
+}
+
+TEST(PerfectHash, EmptySet)
+{
+    PerfectHash hash;
+    EXPECT_TRUE(hash.build({}));
+    EXPECT_TRUE(hash.empty());
+}
@@ -0,0 +1,174 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sw_watchdog/rcu.hpp"
+
+using sw_watchdog::RcuCell;
+
+namespace
+{
+
+/// Blocks a thread in between two steps of a test
+class Gate
+{
+public:
+    void open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        cv_.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return open_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool open_ = false;
+};
+
+} // anonymous ns
+
+TEST(RcuCell, ReclaimsOnceReadersAreQuiescent)
+{
+    RcuCell<int> cell(std::make_unique<const int>(1));
+    Gate read, updated;
+    std::thread reader([&]() {
+        EXPECT_EQ(*cell.read(), 1);
+        read.open();
+        updated.wait();
+        cell.quiescent_state();
+    });
+    read.wait();
+    cell.update(std::make_unique<const int>(2));
+    // The reader may still hold the first snapshot
+    EXPECT_EQ(cell.pending(), 1u);
+    updated.open();
+    reader.join();
+    EXPECT_EQ(cell.reclaim(), 1u);
+    EXPECT_EQ(*cell.read(), 2);
+}
+
+TEST(RcuCell, ReaderOfAnotherCellDoesNotBlock)
+{
+    RcuCell<int> held(std::make_unique<const int>(1));
+    RcuCell<int> cell(std::make_unique<const int>(1));
+    Gate read, done;
+    std::thread reader([&]() {
+        (void) held.read();
+        (void) cell.read();
+        cell.quiescent_state();
+        read.open();
+        done.wait();
+    });
+    read.wait();
+    cell.update(std::make_unique<const int>(2));
+    EXPECT_EQ(cell.pending(), 0u);
+    held.update(std::make_unique<const int>(2));
+    EXPECT_EQ(held.pending(), 1u);
+    done.open();
+    reader.join();
+}
+
+TEST(RcuCell, ExitedReaderDoesNotBlock)
+{
+    RcuCell<int> cell(std::make_unique<const int>(1));
+    // Reads once and exits without a quiescent state
+    std::thread([&cell]() { (void) cell.read(); }).join();
+    cell.update(std::make_unique<const int>(2));
+    EXPECT_EQ(cell.pending(), 0u);
+    // A new thread reusing the slot is tracked again
+    Gate read, updated;
+    std::thread reader([&]() {
+        (void) cell.read();
+        read.open();
+        updated.wait();
+    });
+    read.wait();
+    cell.update(std::make_unique<const int>(3));
+    EXPECT_EQ(cell.pending(), 1u);
+    updated.open();
+    reader.join();
+    EXPECT_EQ(cell.reclaim(), 1u);
+}
+
+TEST(RcuCell, UpdateIsQuiescentStateOfWriter)
+{
+    RcuCell<int> cell(std::make_unique<const int>(1));
+    for(int i = 2; i < 10; ++i)
+        cell.update(std::make_unique<const int>(*cell.read() + 1));
+    EXPECT_EQ(cell.pending(), 0u);
+    EXPECT_EQ(*cell.read(), 9);
+}
+
+TEST(RcuCell, MoreReadersThanSlots)
+{
+    RcuCell<int> cell(std::make_unique<const int>(1));
+    constexpr std::size_t THREADS = sw_watchdog::RCU_MAX_READERS + 8;
+    std::atomic<std::size_t> ready{0};
+    Gate updated;
+    std::vector<std::thread> readers;
+    for(std::size_t i = 0; i < THREADS; ++i)
+        readers.emplace_back([&]() {
+            EXPECT_EQ(*cell.read(), 1);
+            ++ready;
+            updated.wait();
+            cell.quiescent_state();
+        });
+    while(ready.load() < THREADS)
+        std::this_thread::yield();
+    cell.update(std::make_unique<const int>(2));
+    EXPECT_EQ(cell.pending(), 1u);
+    updated.open();
+    for(std::thread & reader : readers)
+        reader.join();
+    // Reclamation resumes once the threads beyond the slots have exited
+    EXPECT_EQ(cell.reclaim(), 1u);
+}
+
+TEST(RcuCell, ConcurrentReadersSeeLiveSnapshots)
+{
+    RcuCell<std::vector<int>> cell(std::make_unique<const std::vector<int>>(64, 0));
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for(int t = 0; t < 4; ++t)
+        readers.emplace_back([&]() {
+            while(!done.load()) {
+                const std::vector<int> * snapshot = cell.read();
+                // All elements of a snapshot are equal; a freed one would trip the sanitizers
+                EXPECT_EQ(snapshot->front(), snapshot->back());
+                cell.quiescent_state();
+            }
+        });
+    for(int i = 1; i < 2000; ++i)
+        cell.update(std::make_unique<const std::vector<int>>(64, i));
+    done.store(true);
+    for(std::thread & reader : readers)
+        reader.join();
+    cell.reclaim();
+    EXPECT_EQ(cell.pending(), 0u);
+}
@@ -0,0 +1,484 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks that the active state of the watchdogs neither allocates nor takes locks in real-time
+// mode. The components are loaded from the package library like a container does, configured and
+// activated with --realtime, and spun by an executor that arms the counters on its thread while
+// one of their callbacks runs: heartbeat subscriptions, QoS events and timers. Every operator new
+// and every mutex or rwlock acquisition is counted, except for those inside the middleware calls
+// of rcl, which are intercepted below; the watchdog has no say over what the rmw does.
+
+#include <gtest/gtest.h>
+
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "class_loader/class_loader.hpp"
+#include "rcl/event.h"
+#include "rcl/publisher.h"
+#include "rcl/subscription.h"
+#include "rcl/timer.h"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp/scope_exit.hpp"
+#include "rclcpp_components/node_factory.hpp"
+
+#if __has_include("rclcpp/version.h")
+#include "rclcpp/version.h"
+#endif
+// Waitables hand over the data taken while the executor was waiting from rclcpp 9 (Galactic) on
+#if defined(RCLCPP_VERSION_MAJOR) && RCLCPP_VERSION_MAJOR >= 9
+#define SW_WATCHDOG_WAITABLE_TAKES_DATA
+#endif
+
+#include "sw_watchdog_msgs/msg/heartbeat.hpp"
+#include "sw_watchdog_msgs/msg/status.hpp"
+#include "sw_watchdog/realtime.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+/// Whether the calling thread runs a callback of the watchdog under test
+thread_local bool counting = false;
+/// Depth of middleware calls of the calling thread, which are not counted
+thread_local int middleware_depth = 0;
+std::atomic<std::size_t> allocations{0};
+std::atomic<std::size_t> locks{0};
+
+bool counted()
+{
+    return counting && middleware_depth == 0;
+}
+
+void * counted_alloc(std::size_t size, std::size_t alignment = 0)
+{
+    if(counted())
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    void * p = nullptr;
+    if(alignment > sizeof(void *))
+        p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    else
+        p = std::malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void counted_free(void * p) noexcept
+{
+    std::free(p);
+}
+
+/// Resolve the definition of name that the interposed one in this executable hides
+template<typename F>
+F next_definition(const char * name)
+{
+    return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+
+/// Call into the middleware without counting what happens there
+template<typename F, typename ... Args>
+auto uncounted(F next, Args ... args)
+{
+    ++middleware_depth;
+    RCLCPP_SCOPE_EXIT(--middleware_depth; );
+    return next(args...);
+}
+
+/// Counts the allocations and lock acquisitions of a scope
+class Counters
+{
+public:
+    Counters()
+    {
+        ::allocations.store(0);
+        ::locks.store(0);
+    }
+    std::size_t allocations() const { return ::allocations.load(); }
+    std::size_t locks() const { return ::locks.load(); }
+};
+
+/// Counts on the calling thread while alive
+class CountingScope
+{
+public:
+    CountingScope() { counting = true; }
+    ~CountingScope() { counting = false; }
+};
+
+/// Single-threaded executor that counts while it runs a callback of the node under test
+/**
+ * Messages are taken into one preallocated message per subscription before the count starts,
+ * rclcpp's executor would allocate a fresh one per dispatch. Services and the callbacks of other
+ * nodes run uncounted.
+ */
+class CountingExecutor : public rclcpp::executors::SingleThreadedExecutor
+{
+public:
+    explicit CountingExecutor(rclcpp::node_interfaces::NodeBaseInterface::SharedPtr counted_node)
+        : counted_node_(counted_node)
+    {}
+
+    void spin() override
+    {
+        if(spinning.exchange(true))
+            throw std::runtime_error("spin() called while already spinning");
+        RCLCPP_SCOPE_EXIT(this->spinning.store(false); );
+        while(rclcpp::ok(this->context_) && spinning.load()) {
+            rclcpp::AnyExecutable any_executable;
+            if(get_next_executable(any_executable, 10ms))
+                dispatch(any_executable);
+        }
+    }
+
+    /// Number of callbacks of the node under test that ran counted
+    std::size_t counted_callbacks() const { return counted_callbacks_.load(); }
+
+private:
+    void dispatch(rclcpp::AnyExecutable & any_executable)
+    {
+        if(any_executable.node_base != counted_node_ || any_executable.service ||
+           any_executable.client ||
+           (any_executable.subscription && any_executable.subscription->is_serialized())) {
+            execute_any_executable(any_executable);
+            return;
+        }
+        if(any_executable.subscription) {
+            rclcpp::SubscriptionBase * subscription = any_executable.subscription.get();
+            auto message = messages_.find(subscription);
+            if(message == messages_.end())
+                message = messages_.emplace(subscription, subscription->create_message()).first;
+            rclcpp::MessageInfo info;
+            if(subscription->take_type_erased(message->second.get(), info)) {
+                CountingScope scope;
+                subscription->handle_message(message->second, info);
+            }
+        } else if(any_executable.timer) {
+            CountingScope scope;
+            any_executable.timer->execute_callback();
+        } else if(any_executable.waitable) {
+            CountingScope scope;
+#ifdef SW_WATCHDOG_WAITABLE_TAKES_DATA
+            any_executable.waitable->execute(any_executable.data);
+#else
+            any_executable.waitable->execute();
+#endif
+        }
+        ++counted_callbacks_;
+        if(any_executable.callback_group)
+            any_executable.callback_group->can_be_taken_from().store(true);
+    }
+
+    rclcpp::node_interfaces::NodeBaseInterface::SharedPtr counted_node_;
+    std::map<rclcpp::SubscriptionBase *, std::shared_ptr<void>> messages_;
+    std::atomic<std::size_t> counted_callbacks_{0};
+};
+
+/// Publishes the heartbeats of the given checkpoint ids, one writer per id like SimpleHeartbeat
+class Sources
+{
+public:
+    Sources(rclcpp::Node & node, const std::vector<uint16_t> & checkpoint_ids)
+    {
+        // As SimpleHeartbeat with a period of 50 ms
+        rclcpp::QoS qos(1);
+        qos.liveliness(RMW_QOS_POLICY_LIVELINESS_MANUAL_BY_TOPIC)
+            .liveliness_lease_duration(70ms)
+            .deadline(70ms);
+        for(uint16_t checkpoint_id : checkpoint_ids)
+            publishers_.emplace_back(
+                checkpoint_id,
+                node.create_publisher<sw_watchdog_msgs::msg::Heartbeat>("heartbeat", qos));
+        clock_ = node.get_clock();
+    }
+
+    /// Send one heartbeat per source, except for those whose id is below silent_below
+    void beat(int msg_nr, uint16_t silent_below = 0)
+    {
+        sw_watchdog_msgs::msg::Heartbeat message;
+        message.header.stamp = clock_->now();
+        message.msg_nr = msg_nr;
+        for(auto & publisher : publishers_) {
+            if(publisher.first < silent_below)
+                continue;
+            message.checkpoint_id = publisher.first;
+            publisher.second->publish(message);
+        }
+    }
+
+private:
+    std::vector<std::pair<uint16_t,
+        rclcpp::Publisher<sw_watchdog_msgs::msg::Heartbeat>::SharedPtr>> publishers_;
+    rclcpp::Clock::SharedPtr clock_;
+};
+
+} // anonymous ns
+
+void * operator new(std::size_t size) { return counted_alloc(size); }
+void * operator new[](std::size_t size) { return counted_alloc(size); }
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void * p) noexcept { counted_free(p); }
+void operator delete[](void * p) noexcept { counted_free(p); }
+void operator delete(void * p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void * p, std::size_t) noexcept { counted_free(p); }
+void operator delete(void * p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void * p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+
+// Lock acquisitions of the whole process, std::mutex included, go through these
+extern "C" int pthread_mutex_lock(pthread_mutex_t * mutex)
+{
+    static const auto next = next_definition<decltype(&pthread_mutex_lock)>("pthread_mutex_lock");
+    if(counted())
+        locks.fetch_add(1, std::memory_order_relaxed);
+    return next(mutex);
+}
+
+extern "C" int pthread_mutex_trylock(pthread_mutex_t * mutex)
+{
+    static const auto next =
+        next_definition<decltype(&pthread_mutex_trylock)>("pthread_mutex_trylock");
+    if(counted())
+        locks.fetch_add(1, std::memory_order_relaxed);
+    return next(mutex);
+}
+
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t * rwlock)
+{
+    static const auto next =
+        next_definition<decltype(&pthread_rwlock_rdlock)>("pthread_rwlock_rdlock");
+    if(counted())
+        locks.fetch_add(1, std::memory_order_relaxed);
+    return next(rwlock);
+}
+
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t * rwlock)
+{
+    static const auto next =
+        next_definition<decltype(&pthread_rwlock_wrlock)>("pthread_rwlock_wrlock");
+    if(counted())
+        locks.fetch_add(1, std::memory_order_relaxed);
+    return next(rwlock);
+}
+
+// The middleware entry points the watchdogs reach from their callbacks
+extern "C" rcl_ret_t rcl_take(const rcl_subscription_t * subscription, void * ros_message,
+                              rmw_message_info_t * message_info,
+                              rmw_subscription_allocation_t * allocation)
+{
+    static const auto next = next_definition<decltype(&rcl_take)>("rcl_take");
+    return uncounted(next, subscription, ros_message, message_info, allocation);
+}
+
+extern "C" rcl_ret_t rcl_take_serialized_message(
+    const rcl_subscription_t * subscription, rcl_serialized_message_t * serialized_message,
+    rmw_message_info_t * message_info, rmw_subscription_allocation_t * allocation)
+{
+    static const auto next =
+        next_definition<decltype(&rcl_take_serialized_message)>("rcl_take_serialized_message");
+    return uncounted(next, subscription, serialized_message, message_info, allocation);
+}
+
+extern "C" rcl_ret_t rcl_take_event(const rcl_event_t * event, void * event_info)
+{
+    static const auto next = next_definition<decltype(&rcl_take_event)>("rcl_take_event");
+    return uncounted(next, event, event_info);
+}
+
+extern "C" rcl_ret_t rcl_publish(const rcl_publisher_t * publisher, const void * ros_message,
+                                 rmw_publisher_allocation_t * allocation)
+{
+    static const auto next = next_definition<decltype(&rcl_publish)>("rcl_publish");
+    return uncounted(next, publisher, ros_message, allocation);
+}
+
+extern "C" rcl_ret_t rcl_timer_call(rcl_timer_t * timer)
+{
+    static const auto next = next_definition<decltype(&rcl_timer_call)>("rcl_timer_call");
+    return uncounted(next, timer);
+}
+
+extern "C" rcl_ret_t rcl_timer_reset(rcl_timer_t * timer)
+{
+    static const auto next = next_definition<decltype(&rcl_timer_reset)>("rcl_timer_reset");
+    return uncounted(next, timer);
+}
+
+extern "C" rcl_ret_t rcl_timer_cancel(rcl_timer_t * timer)
+{
+    static const auto next = next_definition<decltype(&rcl_timer_cancel)>("rcl_timer_cancel");
+    return uncounted(next, timer);
+}
+
+TEST(RealtimeAllocations, HooksCountAllocationsAndLocks)
+{
+    Counters counters;
+    {
+        CountingScope scope;
+        auto p = std::make_unique<int>(0);
+        std::mutex mutex;
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    EXPECT_EQ(counters.allocations(), 1u);
+    EXPECT_EQ(counters.locks(), 1u);
+}
+
+class RealtimeWatchdog : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::string error;
+        // --realtime locks the memory of the process; where that is denied, it cannot configure
+        if(!sw_watchdog::lock_memory(&error))
+            GTEST_SKIP() << "Real-time mode is not available here: " << error;
+        rclcpp::init(0, nullptr);
+        loader_ = std::make_unique<class_loader::ClassLoader>(SW_WATCHDOG_LIBRARY);
+    }
+
+    void TearDown() override
+    {
+        if(!loader_)
+            return;
+        watchdog_ = rclcpp_components::NodeInstanceWrapper();
+        loader_.reset();
+        rclcpp::shutdown();
+    }
+
+    /// Load, configure and activate the watchdog
+    void load(const std::string & plugin, const rclcpp::NodeOptions & options)
+    {
+        const auto factory = loader_->createInstance<rclcpp_components::NodeFactory>(
+            "rclcpp_components::NodeFactoryTemplate<" + plugin + ">");
+        watchdog_ = factory->create_node_instance(options);
+    }
+
+    /// Spin the watchdog and an observer of its reports while run() sends heartbeats
+    /**
+     * Only reports about checkpoint ids up to max_checkpoint_id are counted.
+     */
+    template<typename F>
+    void spin(const std::string & report_topic, uint16_t max_checkpoint_id, F && run)
+    {
+        auto observer = std::make_shared<rclcpp::Node>("observer");
+        auto report_sub = observer->create_subscription<sw_watchdog_msgs::msg::Status>(
+            report_topic, 10,
+            [this, max_checkpoint_id](const sw_watchdog_msgs::msg::Status::SharedPtr msg) {
+                if(msg->checkpoint_id <= max_checkpoint_id)
+                    ++reports_;
+            });
+        CountingExecutor executor(watchdog_.get_node_base_interface());
+        executor.add_node(watchdog_.get_node_base_interface());
+        executor.add_node(observer);
+        std::thread thread([&executor]() { executor.spin(); });
+        run(*observer);
+        executor.cancel();
+        thread.join();
+        counted_callbacks_ = executor.counted_callbacks();
+    }
+
+    std::unique_ptr<class_loader::ClassLoader> loader_;
+    rclcpp_components::NodeInstanceWrapper watchdog_;
+    std::atomic<std::size_t> reports_{0};
+    std::size_t counted_callbacks_ = 0;
+};
+
+TEST_F(RealtimeWatchdog, SimpleWatchdogHeartbeatAndExpiryPaths)
+{
+    rclcpp::NodeOptions options;
+    options.arguments({"simple_watchdog", "100", "--publish", "--activate", "--realtime"});
+    // Two hosts, so expiries are correlated before they are published
+    options.parameter_overrides({
+        rclcpp::Parameter("topology", std::vector<std::string>{
+            "1:a", "2:a", "3:a", "4:b", "5:b", "6:b"}),
+        rclcpp::Parameter("groups", std::vector<std::string>{"front:2:1,2,3"}),
+        rclcpp::Parameter("dependencies", std::vector<std::string>{"5:4", "6:4"}),
+        rclcpp::Parameter("sync_sets", std::vector<std::string>{"rear:10:4,5,6"}),
+        rclcpp::Parameter("flap_half_life", 1000)});
+    load("sw_watchdog::SimpleWatchdog", options);
+
+    Counters counters;
+    spin("failure", 3, [this](rclcpp::Node & observer) {
+        Sources sources(observer, {1, 2, 3, 4, 5, 6});
+        for(int msg_nr = 1; msg_nr <= 20; ++msg_nr) {
+            sources.beat(msg_nr);
+            std::this_thread::sleep_for(50ms);
+        }
+        // Host a goes away and its expiries are reported; host b stays alive, and its sync set
+        // and dependencies stay satisfied
+        const auto deadline = std::chrono::steady_clock::now() + 2s;
+        for(int msg_nr = 21; reports_.load() == 0 &&
+            std::chrono::steady_clock::now() < deadline; ++msg_nr) {
+            sources.beat(msg_nr, 4);
+            std::this_thread::sleep_for(50ms);
+        }
+    });
+    EXPECT_GT(reports_.load(), 0u);
+    EXPECT_GT(counted_callbacks_, 0u);
+    EXPECT_EQ(counters.allocations(), 0u);
+    EXPECT_EQ(counters.locks(), 0u);
+}
+
+TEST_F(RealtimeWatchdog, WindowedWatchdogHeartbeatAndDeadlinePaths)
+{
+    rclcpp::NodeOptions options;
+    // Misses stay below max-misses, so the watchdog does not leave the active state
+    options.arguments({"windowed_watchdog", "100", "1000", "--publish", "--activate",
+                       "--realtime"});
+    options.parameter_overrides({rclcpp::Parameter("flap_half_life", 1000)});
+    load("sw_watchdog::WindowedWatchdog", options);
+
+    Counters counters;
+    // The windowed watchdog watches a single entity and reports it as checkpoint id 0
+    spin("status", 0, [this](rclcpp::Node & observer) {
+        Sources sources(observer, {1});
+        for(int msg_nr = 1; msg_nr <= 20; ++msg_nr) {
+            sources.beat(msg_nr);
+            std::this_thread::sleep_for(50ms);
+        }
+        // Silence makes the deadline expire
+        const auto deadline = std::chrono::steady_clock::now() + 2s;
+        while(reports_.load() == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(10ms);
+        // And the recovery resets the misses
+        sources.beat(21);
+        std::this_thread::sleep_for(50ms);
+    });
+    EXPECT_GT(reports_.load(), 0u);
+    EXPECT_GT(counted_callbacks_, 0u);
+    EXPECT_EQ(counters.allocations(), 0u);
+    EXPECT_EQ(counters.locks(), 0u);
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "sw_watchdog/sharded_counter.hpp"
+
+using sw_watchdog::ShardedCounter;
+
+TEST(ShardedCounter, SumsAllShards)
+{
+    ShardedCounter<4> counter;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; ++t)
+        threads.emplace_back([&counter]() {
+            for(int i = 0; i < 1000; ++i)
+                counter.add(1);
+        });
+    for(std::thread & thread : threads)
+        thread.join();
+    EXPECT_EQ(counter.load(), 8000u);
+    EXPECT_EQ(counter.reset(), 8000u);
+    EXPECT_EQ(counter.load(), 0u);
+}
+
+TEST(ShardedCounter, ResetLosesNoConcurrentAdd)
+{
+    constexpr uint64_t ADDS = 200000;
+    ShardedCounter<> counter;
+    std::atomic<bool> done{false};
+    uint64_t taken = 0;
+    std::thread resetter([&]() {
+        while(!done.load(std::memory_order_acquire))
+            taken += counter.reset();
+    });
+    std::vector<std::thread> adders;
+    for(int t = 0; t < 4; ++t)
+        adders.emplace_back([&counter]() {
+            for(uint64_t i = 0; i < ADDS; ++i)
+                counter.add(1);
+        });
+    for(std::thread & adder : adders)
+        adder.join();
+    done.store(true, std::memory_order_release);
+    resetter.join();
+    // Every add is either taken by a reset or still in the counter
+    EXPECT_EQ(taken + counter.load(), 4 * ADDS);
+}
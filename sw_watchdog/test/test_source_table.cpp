@@ -0,0 +1,163 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "sw_watchdog/source_table.hpp"
+
+using sw_watchdog::SlotIndex;
+using sw_watchdog::SourceState;
+using sw_watchdog::SourceTable;
+
+namespace
+{
+
+/// Record a heartbeat of a source the way the watchdog does
+SourceState * beat(SourceTable & table, uint16_t checkpoint_id, int64_t now_ns)
+{
+    SourceState * source = table.get_or_insert(checkpoint_id, now_ns, 100);
+    if(source)
+        source->last_seen_ns = now_ns;
+    return source;
+}
+
+} // anonymous ns
+
+TEST(SourceTable, EvictsLeastRecentlyHeardWhenFull)
+{
+    SourceTable table(2);
+    ASSERT_NE(beat(table, 1, 0), nullptr);
+    ASSERT_NE(beat(table, 2, 10), nullptr);
+    // Neither source has been silent for longer than the retention yet
+    EXPECT_EQ(beat(table, 3, 50), nullptr);
+    // Source 1 has, and is the least recently heard
+    ASSERT_NE(beat(table, 3, 101), nullptr);
+    EXPECT_EQ(table.find(1), nullptr);
+    EXPECT_NE(table.find(2), nullptr);
+    EXPECT_EQ(table.evictions(), 1u);
+}
+
+TEST(SourceTable, ResetClearsEvictions)
+{
+    SourceTable table(1);
+    beat(table, 1, 0);
+    ASSERT_NE(beat(table, 2, 101), nullptr);
+    ASSERT_EQ(table.evictions(), 1u);
+    table.reset(1);
+    EXPECT_EQ(table.evictions(), 0u);
+    EXPECT_EQ(table.size(), 0u);
+}
+
+TEST(SourceTable, RetiredSourceIsEvictedFirst)
+{
+    SourceTable table(2);
+    beat(table, 1, 0);
+    SourceState * departing = beat(table, 2, 10);
+    table.retire(*departing);
+    ASSERT_NE(beat(table, 3, 20), nullptr);
+    EXPECT_EQ(table.find(2), nullptr);
+    EXPECT_NE(table.find(1), nullptr);
+}
+
+TEST(SourceTable, EvictStaleStopsAtFirstLiveSource)
+{
+    SourceTable table(4);
+    beat(table, 1, 0);
+    beat(table, 2, 50);
+    beat(table, 3, 200);
+    table.retire(*table.find(3));
+    // Source 3 departed, source 1 is silent for too long, source 2 not yet
+    EXPECT_EQ(table.evict_stale(120, 100), 2u);
+    EXPECT_EQ(table.size(), 1u);
+    EXPECT_NE(table.find(2), nullptr);
+    EXPECT_EQ(table.evict_stale(120, 100), 0u);
+    // Freed slots are reused
+    for(uint16_t id = 10; id < 13; ++id)
+        EXPECT_NE(beat(table, id, 130), nullptr);
+    EXPECT_EQ(table.size(), 4u);
+}
+
+TEST(SlotIndex, BackwardShiftKeepsProbeSequencesIntact)
+{
+    // Few buckets for many erases, so probe sequences collide and wrap around
+    SlotIndex index;
+    index.reset(8, {1000, 2000, 3000});
+    std::map<uint16_t, uint32_t> expected;
+    std::mt19937 random(7);
+    for(int step = 0; step < 20000; ++step) {
+        // Dense ids, statically configured ids and probed ids alike
+        const uint16_t id = static_cast<uint16_t>(random() % 2 ? random() % 16 :
+                                                  random() % 4 ? 8 + random() % 64 :
+                                                  1000 * (1 + random() % 3));
+        const auto found = expected.find(id);
+        if(found != expected.end()) {
+            ASSERT_EQ(index.find(id), found->second);
+            index.erase(id);
+            expected.erase(found);
+            ASSERT_EQ(index.find(id), SlotIndex::NIL);
+        } else if(expected.size() < 8) {
+            ASSERT_EQ(index.find(id), SlotIndex::NIL);
+            index.insert(id, static_cast<uint32_t>(step));
+            expected[id] = static_cast<uint32_t>(step);
+        }
+        for(const auto & entry : expected)
+            ASSERT_EQ(index.find(entry.first), entry.second) << "step " << step;
+    }
+}
+
+TEST(SourceTable, LeastHealthyInKeyOrder)
+{
+    SourceTable table(32);
+    std::mt19937 random(11);
+    std::vector<int64_t> keys;
+    for(uint16_t id = 0; id < 32; ++id) {
+        SourceState * source = beat(table, id, 0);
+        const int64_t key = static_cast<int64_t>(random() % 1000);
+        table.update_health(*source, key);
+        keys.push_back(key);
+    }
+    // Move one source to the front, another one to the back
+    table.update_health(*table.find(5), -1);
+    keys[5] = -1;
+    table.update_health(*table.find(6), 5000);
+    keys[6] = 5000;
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int64_t> walked;
+    table.for_each_least_healthy(10, [&walked](SourceState & source) {
+        walked.push_back(source.health_key);
+    });
+    EXPECT_EQ(walked, std::vector<int64_t>(keys.begin(), keys.begin() + 10));
+    EXPECT_EQ(table.find(5)->health_key, walked.front());
+}
+
+TEST(SourceTable, EvictedSourceLeavesTheHealthRanking)
+{
+    SourceTable table(2);
+    table.update_health(*beat(table, 1, 0), 10);
+    table.update_health(*beat(table, 2, 50), 20);
+    beat(table, 3, 200);
+    std::vector<uint16_t> walked;
+    table.for_each_least_healthy(sw_watchdog::MAX_HEALTH_RANKING, [&walked](SourceState & s) {
+        walked.push_back(s.checkpoint_id);
+    });
+    EXPECT_EQ(walked.size(), 2u);
+    EXPECT_EQ(std::count(walked.begin(), walked.end(), 1), 0);
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "sw_watchdog/sync_sets.hpp"
+
+using sw_watchdog::SYNC_MISSED;
+using sw_watchdog::SyncSets;
+using sw_watchdog::SyncState;
+
+namespace
+{
+
+/// Position in the set and reported skew
+using Report = std::tuple<uint16_t, int64_t>;
+
+class SyncStateTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::string error;
+        // Members 1, 2 and 3 at positions 0, 1 and 2 with a maximum skew of 10 ms
+        ASSERT_TRUE(sets_.build({"front:10:1,2,3"}, &error)) << error;
+        state_.reset(sets_);
+    }
+
+    /// Heartbeat of checkpoint id at now_ms, returns the reports it caused with skews in ms
+    std::vector<Report> beat(uint16_t checkpoint_id, int64_t now_ms)
+    {
+        std::vector<Report> reports;
+        state_.arrive(sets_, sets_.member(checkpoint_id), now_ms * 1000000,
+                      [&reports](uint32_t set, uint16_t position, int64_t skew_ns) {
+                          EXPECT_EQ(set, 0u);
+                          reports.emplace_back(position, skew_ns < 0 ? skew_ns : skew_ns / 1000000);
+                      });
+        return reports;
+    }
+
+    /// One cycle of all three members within the maximum skew
+    void cycle(int64_t start_ms)
+    {
+        EXPECT_TRUE(beat(1, start_ms).empty());
+        EXPECT_TRUE(beat(2, start_ms + 1).empty());
+        EXPECT_TRUE(beat(3, start_ms + 2).empty());
+    }
+
+    SyncSets sets_;
+    SyncState state_;
+};
+
+} // anonymous ns
+
+TEST_F(SyncStateTest, ArmsOnceAllMembersWereHeard)
+{
+    // Arming arrivals are never checked, however far apart
+    EXPECT_TRUE(beat(1, 0).empty());
+    EXPECT_TRUE(beat(1, 50).empty());
+    EXPECT_TRUE(beat(2, 60).empty());
+    EXPECT_TRUE(beat(3, 200).empty());
+    cycle(1000);
+    cycle(2000);
+}
+
+TEST_F(SyncStateTest, ReportsSkewOfTheLastMember)
+{
+    cycle(0);
+    EXPECT_TRUE(beat(2, 100).empty());
+    EXPECT_TRUE(beat(1, 105).empty());
+    EXPECT_EQ(beat(3, 125), std::vector<Report>{Report(2, 25)});
+    cycle(200);
+}
+
+TEST_F(SyncStateTest, SkippedBeatIsReportedOnceAndCyclesStayAligned)
+{
+    cycle(0);
+    // Member 3 skips the second cycle
+    EXPECT_TRUE(beat(1, 100).empty());
+    EXPECT_TRUE(beat(2, 101).empty());
+    EXPECT_EQ(beat(1, 200), std::vector<Report>{Report(2, SYNC_MISSED)});
+    EXPECT_TRUE(beat(2, 201).empty());
+    EXPECT_TRUE(beat(3, 202).empty());
+    // Counting beats would now pair member 3 with the previous cycle of the others
+    cycle(300);
+    cycle(400);
+}
+
+TEST_F(SyncStateTest, DisarmedSetWaitsForAllMembers)
+{
+    cycle(0);
+    EXPECT_TRUE(beat(1, 100).empty());
+    state_.disarm(sets_, sets_.member(3));
+    EXPECT_TRUE(beat(1, 200).empty());
+    EXPECT_TRUE(beat(2, 201).empty());
+    EXPECT_TRUE(beat(1, 300).empty());
+    EXPECT_TRUE(beat(3, 350).empty());
+    cycle(400);
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "sw_watchdog/topic_age.hpp"
+
+using sw_watchdog::TopicAgeLimits;
+using sw_watchdog::TopicAgeReport;
+using sw_watchdog::TopicAgeState;
+using sw_watchdog::topic_age_arrival;
+using sw_watchdog::topic_age_report;
+
+namespace
+{
+
+constexpr int64_t MS = 1000000;
+constexpr int64_t PERIOD_NS = 1000 * MS;
+
+class TopicAgeTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // At most 100 ms old and 5 Hz, activated at 10 s
+        limits_.max_age_ns = 100 * MS;
+        limits_.min_rate_hz = 5.0;
+    }
+
+    /// Messages at 10 Hz for one period ending at end_ms, each age_ms old on arrival
+    void period(int64_t end_ms, int64_t age_ms)
+    {
+        for(int64_t arrival_ms = end_ms - 900; arrival_ms <= end_ms; arrival_ms += 100)
+            topic_age_arrival(state_, limits_, (arrival_ms - age_ms) * MS, arrival_ms * MS);
+    }
+
+    TopicAgeReport report(int64_t now_ms)
+    {
+        return topic_age_report(state_, limits_, now_ms * MS, PERIOD_NS, ACTIVE_SINCE_MS * MS);
+    }
+
+    static constexpr int64_t ACTIVE_SINCE_MS = 10000;
+    TopicAgeLimits limits_;
+    TopicAgeState state_;
+};
+
+} // anonymous ns
+
+TEST_F(TopicAgeTest, HealthyTopic)
+{
+    period(11000, 20);
+    const TopicAgeReport healthy = report(11000);
+    EXPECT_EQ(healthy.messages, 10u);
+    EXPECT_FLOAT_EQ(healthy.rate_hz, 10.0f);
+    EXPECT_EQ(healthy.age_ns, 20 * MS);
+    EXPECT_EQ(healthy.max_age_ns, 20 * MS);
+    EXPECT_FALSE(healthy.stale);
+    EXPECT_FALSE(healthy.slow);
+    EXPECT_FALSE(healthy.became_silent);
+    EXPECT_FALSE(healthy.became_slow);
+}
+
+TEST_F(TopicAgeTest, StaleMessageFlagsOnePeriod)
+{
+    EXPECT_FALSE(topic_age_arrival(state_, limits_, 10000 * MS, 10020 * MS));
+    // Only the first message over the limit in a period is reported
+    EXPECT_TRUE(topic_age_arrival(state_, limits_, 10000 * MS, 10200 * MS));
+    EXPECT_FALSE(topic_age_arrival(state_, limits_, 10100 * MS, 10300 * MS));
+    const TopicAgeReport stale = report(10300);
+    EXPECT_TRUE(stale.stale);
+    EXPECT_EQ(stale.max_age_ns, 200 * MS);
+    EXPECT_EQ(stale.age_ns, 200 * MS);
+
+    period(11300, 20);
+    const TopicAgeReport recovered = report(11300);
+    EXPECT_FALSE(recovered.stale);
+    EXPECT_EQ(recovered.max_age_ns, 20 * MS);
+}
+
+TEST_F(TopicAgeTest, StampsOutOfOrderKeepTheNewest)
+{
+    topic_age_arrival(state_, limits_, 10050 * MS, 10060 * MS);
+    topic_age_arrival(state_, limits_, 10010 * MS, 10070 * MS);
+    EXPECT_EQ(state_.newest_stamp_ns, 10050 * MS);
+    EXPECT_EQ(report(10080).age_ns, 30 * MS);
+}
+
+TEST_F(TopicAgeTest, SilentTopicKeepsAging)
+{
+    period(11000, 20);
+    EXPECT_FALSE(report(11000).stale);
+
+    // No message after the one stamped 10980 ms
+    const TopicAgeReport silent = report(12000);
+    EXPECT_EQ(silent.messages, 0u);
+    EXPECT_EQ(silent.age_ns, 1020 * MS);
+    EXPECT_EQ(silent.silent_ns, 1020 * MS);
+    EXPECT_TRUE(silent.stale);
+    EXPECT_TRUE(silent.became_silent);
+    EXPECT_TRUE(silent.slow);
+    EXPECT_TRUE(silent.became_slow);
+
+    // Still stale, but reported as a transition only once
+    const TopicAgeReport still_silent = report(13000);
+    EXPECT_EQ(still_silent.age_ns, 2020 * MS);
+    EXPECT_TRUE(still_silent.stale);
+    EXPECT_FALSE(still_silent.became_silent);
+    EXPECT_FALSE(still_silent.became_slow);
+
+    period(14000, 20);
+    const TopicAgeReport back = report(14000);
+    EXPECT_FALSE(back.stale);
+    EXPECT_FALSE(back.slow);
+    EXPECT_FALSE(state_.silent);
+}
+
+TEST_F(TopicAgeTest, NeverReceivedAgesFromActivation)
+{
+    const TopicAgeReport early = report(10050);
+    EXPECT_EQ(early.age_ns, -1);
+    EXPECT_EQ(early.silent_ns, 50 * MS);
+    EXPECT_FALSE(early.stale);
+
+    const TopicAgeReport silent = report(11000);
+    EXPECT_EQ(silent.age_ns, -1);
+    EXPECT_EQ(silent.silent_ns, 1000 * MS);
+    EXPECT_TRUE(silent.stale);
+    EXPECT_TRUE(silent.became_silent);
+}
+
+TEST_F(TopicAgeTest, SlowTopic)
+{
+    for(int64_t arrival_ms = 10250; arrival_ms <= 11000; arrival_ms += 250)
+        topic_age_arrival(state_, limits_, arrival_ms * MS, arrival_ms * MS);
+    const TopicAgeReport slow = report(11000);
+    EXPECT_FLOAT_EQ(slow.rate_hz, 4.0f);
+    EXPECT_TRUE(slow.slow);
+    EXPECT_TRUE(slow.became_slow);
+    EXPECT_FALSE(slow.stale);
+}
+
+TEST_F(TopicAgeTest, UnlimitedTopicIsNeverFlagged)
+{
+    limits_ = TopicAgeLimits();
+    EXPECT_FALSE(topic_age_arrival(state_, limits_, 0, 10000 * MS));
+    const TopicAgeReport unlimited = report(20000);
+    EXPECT_FALSE(unlimited.stale);
+    EXPECT_FALSE(unlimited.slow);
+    EXPECT_FALSE(unlimited.became_silent);
+    EXPECT_EQ(unlimited.age_ns, 20000 * MS);
+}
+
+TEST_F(TopicAgeTest, ZeroPeriodHasNoRate)
+{
+    period(11000, 20);
+    EXPECT_FLOAT_EQ(topic_age_report(state_, limits_, 11000 * MS, 0,
+                                     ACTIVE_SINCE_MS * MS).rate_hz, 0.0f);
+}
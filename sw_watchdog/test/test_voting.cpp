@@ -0,0 +1,123 @@
+// Copyright (c) 2020 Mapless AI, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sw_watchdog/voting.hpp"
+
+using sw_watchdog::PendingVotes;
+using sw_watchdog::VoterRegistry;
+
+TEST(VoterRegistry, AssignsBitsUntilFull)
+{
+    VoterRegistry voters("self");
+    EXPECT_EQ(voters.bit("self"), sw_watchdog::SELF_VOTE);
+    EXPECT_EQ(voters.bit("a"), 2u);
+    EXPECT_EQ(voters.bit("b"), 4u);
+    EXPECT_EQ(voters.bit("a"), 2u);
+    for(std::size_t i = voters.size(); i < sw_watchdog::MAX_VOTERS; ++i)
+        EXPECT_NE(voters.bit("voter" + std::to_string(i)), 0u);
+    EXPECT_EQ(voters.bit("one too many"), 0u);
+    EXPECT_EQ(sw_watchdog::vote_count(0xff), sw_watchdog::MAX_VOTERS);
+}
+
+TEST(PendingVotes, ExpiresOnlyOldVotes)
+{
+    PendingVotes votes;
+    votes.reset(8);
+    votes.add(0, 1, 2, 0);
+    votes.add(1, 2, 2, 50);
+    std::vector<uint16_t> expired;
+    votes.expire(120, 100, [&expired](const PendingVotes::Vote & vote) {
+        expired.push_back(vote.checkpoint_id);
+    });
+    EXPECT_EQ(expired, std::vector<uint16_t>{1});
+    EXPECT_EQ(votes.size(), 1u);
+}
+
+TEST(PendingVotes, RepeatedVerdictRefreshes)
+{
+    PendingVotes votes;
+    votes.reset(8);
+    votes.add(0, 1, 2, 0);
+    votes.add(0, 1, 2, 80);
+    votes.add(0, 1, 4, 0);
+    EXPECT_EQ(votes.size(), 2u);
+    std::vector<uint8_t> expired;
+    votes.expire(120, 100, [&expired](const PendingVotes::Vote & vote) {
+        expired.push_back(vote.bit);
+    });
+    EXPECT_EQ(expired, std::vector<uint8_t>{4});
+}
+
+TEST(PendingVotes, RevokedVerdictIsForgotten)
+{
+    PendingVotes votes;
+    votes.reset(8);
+    votes.add(0, 1, 2, 0);
+    votes.add(0, 1, 4, 0);
+    votes.remove(0, 1, 2);
+    ASSERT_EQ(votes.size(), 1u);
+    std::size_t expired = 0;
+    votes.expire(1000, 100, [&expired](const PendingVotes::Vote & vote) {
+        EXPECT_EQ(vote.bit, 4u);
+        ++expired;
+    });
+    EXPECT_EQ(expired, 1u);
+    EXPECT_EQ(votes.size(), 0u);
+}
+
+TEST(PendingVotes, ReusedSlotDropsVotesOfPreviousSource)
+{
+    PendingVotes votes;
+    votes.reset(2);
+    votes.add(0, 1, 2, 0);
+    votes.add(0, 1, 4, 0);
+    // Source 1 was evicted and slot 0 went to source 3
+    votes.remove(0, 3, 2);
+    EXPECT_EQ(votes.size(), 2u);
+    votes.add(0, 3, 8, 50);
+    EXPECT_EQ(votes.size(), 1u);
+    std::vector<uint16_t> expired;
+    votes.expire(1000, 100, [&expired](const PendingVotes::Vote & vote) {
+        expired.push_back(vote.checkpoint_id);
+    });
+    EXPECT_EQ(expired, std::vector<uint16_t>{3});
+}
+
+TEST(PendingVotes, MassExpiryKeepsEveryVote)
+{
+    constexpr uint32_t SLOTS = 1000;
+    PendingVotes votes;
+    votes.reset(SLOTS);
+    for(uint32_t slot = 0; slot < SLOTS; ++slot)
+        for(std::size_t voter = 1; voter < sw_watchdog::MAX_VOTERS; ++voter)
+            votes.add(slot, static_cast<uint16_t>(slot), static_cast<uint8_t>(1u << voter),
+                      slot);
+    EXPECT_EQ(votes.size(), SLOTS * (sw_watchdog::MAX_VOTERS - 1));
+    for(uint32_t slot = 0; slot < SLOTS; slot += 2)
+        votes.remove(slot, static_cast<uint16_t>(slot), 2);
+    std::size_t expired = 0;
+    votes.expire(SLOTS / 2 + 100, 100, [&expired](const PendingVotes::Vote & vote) {
+        EXPECT_LT(vote.received_ns, static_cast<int64_t>(SLOTS / 2));
+        ++expired;
+    });
+    // Slots 0 to 499 expire, half of them with one vote revoked
+    EXPECT_EQ(expired, 500 * (sw_watchdog::MAX_VOTERS - 1) - 250);
+    EXPECT_EQ(votes.size(), SLOTS * (sw_watchdog::MAX_VOTERS - 1) - 500 - expired);
+}